@@ -16,12 +16,33 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>         // for INT_MAX
 #include <time.h>           // for srand() and rand()
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>      // for SSE2 lane operations
+#define HAVE_SSE2
+#endif
+
 #ifdef _WIN32
 #include <windows.h>    // for SetConsoleTextAttribute and Sleep
 #else
 #include <unistd.h>     // for sleep() on Linux/macOS
+#include <pthread.h>    // for worker threads on Linux/macOS
+#include <fcntl.h>      // for open() on Linux/macOS
+#include <sys/mman.h>   // for mmap() on Linux/macOS
+#include <sys/stat.h>   // for fstat() on Linux/macOS
+#include <sys/wait.h>   // for waitpid() on Linux/macOS
+#include <dirent.h>     // for opendir() on Linux/macOS
+#include <signal.h>     // for ignoring SIGPIPE on Linux/macOS
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h> // for batched file reads on Linux
+#include <sys/syscall.h>    // for the io_uring system calls
+#include <errno.h>          // for EINTR
+#define HAVE_IO_URING
+#endif
+#endif
 #endif
 
  /**
@@ -29,6 +50,8 @@
   * @{
   */
 #define CYAN    3
+#define BLUE    9
+#define MAGENTA 13
 #define GREEN   10
 #define RED     12
 #define YELLOW  14
@@ -43,6 +66,45 @@
 #define MAXC                105     /**< Maximum number of columns the maze can have */
 #define QSIZE               (MAXR * MAXC)   /**< Maximum size of BFS queue arrays */
 #define MAX_PATHS_TO_SHOW   20      /**< Maximum number of possible paths to display in mode 2 */
+#define NUM_MOVES           4       /**< Moves per cell: the 4 directions (a step onto a portal includes the jump) */
+#define NUM_LINKS           5       /**< Links per cell in the connectivity forest: 4 steps plus the portal pair */
+#define PORTAL_CHARS        "@$&?=~" /**< Characters that mark portal pairs */
+#define MAX_PORTALS         (sizeof(PORTAL_CHARS) - 1) /**< At most one pair per portal character */
+#define MAX_THREADS         64      /**< Upper bound on worker threads used by parallel passes */
+#define STRIP_ROWS          16      /**< Minimum rows per strip in row-parallel passes */
+#define WALL_TOP_K          5       /**< Number of best walls reported by the wall-removal query */
+#define MAX_WALL_BREAKS     15      /**< Largest k accepted by the k-wall-break solver */
+#define MAX_WAYPOINTS       20      /**< Maximum number of 'K' waypoints the routing mode accepts */
+#define HEAP_SIZE           (NUM_MOVES * QSIZE + 1) /**< A* heap entries (at most one per relaxed edge) */
+#define MAX_FLOORS_SHOWN    5       /**< The 3D mode draws the path floor by floor only up to this many floors */
+#define MAX_TIME_PERIOD     2520    /**< Largest LCM of gate periods the space-time BFS accepts */
+#define CONN_LEVELS         15      /**< Levels of the dynamic connectivity forest (more than log2 of the cell count) */
+#define CONN_EDGES          (3 * QSIZE) /**< Edge slots: the down, right and portal link of each cell */
+#define MAX_IDA_EXPANSIONS  20000000 /**< The iterative-deepening solver gives up after this many expansions */
+#define BFS_BYTES_PER_CELL  (5 * sizeof(int)) /**< bfs_shortest: visited flag, two parent maps and two queue arrays */
+#define EXT_RUN_RECORDS     (1 << 20) /**< Records sorted in memory per run by the external-memory BFS */
+#define EXT_FANIN           64      /**< Sorted runs merged at once by the external-memory BFS */
+#define EXT_UNREACHED       0xFFFFFFFFu /**< Distance stored for walls and unreachable cells */
+#define MAX_PARTITIONS      16      /**< Most worker processes used by the partitioned BFS */
+#define PARTITION_WORKER_FLAG "--bfs-worker" /**< Command-line flag that starts a partitioned BFS worker */
+#define BATCH_MAX_FILE      (MAXR * (MAXC + 2) + 4096) /**< Largest maze file the batch solver reads */
+#define BATCH_QUEUE_DEPTH   64      /**< Parsed mazes buffered between the batch readers and solvers */
+#define BATCH_RING_ENTRIES  64      /**< Files the io_uring reader keeps in flight */
+#define BATCH_READERS       4       /**< Reader threads when io_uring is not available */
+#define CACHE_FILE          "maze_cache.bin" /**< On-disk tier of the solution cache */
+#define CACHE_MAGIC         "MZC2"  /**< Header of CACHE_FILE; the digit changes whenever cached paths change meaning */
+#define CACHE_LRU_ENTRIES   256     /**< Results kept in memory by the solution cache */
+#define CACHE_LRU_BUCKETS   512     /**< Hash buckets of the in-memory tier (a power of two) */
+#define CACHE_FLUSH_RECORDS 256     /**< New cache records are written to the file this many at a time */
+#define ROW_BITS            64      /**< Widest maze searched by the word-per-row BFS */
+#define BATCH_LANES         8       /**< Small mazes searched together by the lane BFS */
+#define LANE_SIZE           64      /**< Largest rows and columns of a lane maze (one 64-bit word per row) */
+#define MAX_EXPLORE_TRIALS  100000  /**< Upper limit on seeded trials in the exploration benchmark */
+#define LOOP_OPENING_ODDS   8       /**< Generated mazes open one in this many inner walls to create loops */
+#define MAX_KEY_TYPES       16      /**< Maximum number of distinct key/door letters per maze */
+#define BREAK_QSIZE         (QSIZE * (MAX_WALL_BREAKS + 1)) /**< Each cell enters the break queue at most k + 1 times */
+#define MAX_TERRAIN_COST    9       /**< Largest step cost a terrain digit can carry */
+#define DIAL_POOL           (4 * QSIZE + 1) /**< Bucket entries needed by Dial's algorithm (one per relaxation) */
    /** @} */
 
    /**
@@ -62,6 +124,52 @@ int qc[QSIZE];                      /**< Column coordinates for BFS queue */
 int front, rear;                    /**< Front and rear pointers of the circular queue */
 int dr[] = { -1, 1, 0, 0 };           /**< Delta row for 4 directions: up, down, left, right */
 int dc[] = { 0, 0, -1, 1 };           /**< Delta column for 4 directions */
+int portal_to[MAXR][MAXC];          /**< Partner cell index (r * MAXC + c) of each portal cell, -1 elsewhere */
+int portal_a[MAX_PORTALS], portal_b[MAX_PORTALS]; /**< Cell indices of the two ends of each portal pair */
+int num_portals;                    /**< Number of portal pairs in the maze */
+int wrap_mode;                      /**< 1 if the maze is toroidal (";wrap" directive), 0 if bounded */
+int gate_period[256];               /**< Period p of each gate character (0 if the character is not a gate) */
+int gate_open[256];                 /**< A gate is open on ticks where t mod p < gate_open */
+int next_row[4][MAXR];              /**< Row reached by direction d from each row (-1 if outside the maze) */
+int next_col[4][MAXC];              /**< Column reached by direction d from each column (-1 if outside the maze) */
+int uf_parent[QSIZE];               /**< Union-find parent links, indexed by r * MAXC + c */
+int run_start[MAXR][MAXC];          /**< First column of each run of open cells in a row */
+int run_end[MAXR][MAXC];            /**< Last column of each run of open cells in a row */
+int run_count[MAXR];                /**< Number of open-cell runs in each row */
+int num_components;                 /**< Number of connected open regions in the maze */
+int labels_stale;                   /**< 1 once walls were edited after labeling (labels may be wrong) */
+int conn_ready;                     /**< 1 while the dynamic connectivity forest matches the maze */
+int use_row_bfs;                    /**< 1 if every row fits in one 64-bit word, so bfs_shortest uses row_bfs */
+unsigned long long maze_hash;       /**< Content hash of the maze (see grid_hash), computed by load_maze */
+int maze_hash_stale;                /**< 1 once walls were edited after hashing */
+int dial_head[MAX_TERRAIN_COST + 1]; /**< First entry of each Dial bucket (-1 if empty) */
+int dial_next[DIAL_POOL];           /**< Next entry in the same Dial bucket */
+int dial_cell[DIAL_POOL];           /**< Cell index (r * MAXC + c) stored in each entry */
+int deque_cell[DIAL_POOL];          /**< Circular deque of cell indices for 0-1 BFS */
+int starts_r[QSIZE], starts_c[QSIZE]; /**< Every 'S' cell in reading order */
+int exits_r[QSIZE], exits_c[QSIZE]; /**< Every 'E' cell in reading order */
+int num_starts, num_exits;          /**< Number of 'S' and 'E' cells in the maze */
+int dist_from_s[MAXR][MAXC];        /**< BFS distances from 'S' (-1 if unreachable) */
+int dist_from_e[MAXR][MAXC];        /**< BFS distances to 'E', following moves backwards (-1 if 'E' is out of reach) */
+int order_from_s[QSIZE];            /**< Cells in the order the BFS from 'S' reached them */
+int order_from_e[QSIZE];            /**< Cells in the order the backward BFS from 'E' reached them */
+int post_num[MAXR][MAXC];           /**< DFS postorder number of each cell reached from 'S' (-1 if not reached) */
+int post_cell[QSIZE];               /**< Cell index (r * MAXC + c) for each postorder number */
+int idom[QSIZE];                    /**< Immediate dominator of each postorder number (-1 if undefined) */
+signed char best_left[MAXR][MAXC];  /**< Most wall breaks still available on arrival at each cell (-1 if unvisited) */
+int break_state[BREAK_QSIZE];       /**< Packed (cell index * 16 + breaks left) states of the break BFS queue */
+int break_parent[BREAK_QSIZE];      /**< Queue position of the state each break-BFS state came from */
+int key_bit[26];                    /**< Key-mask bit of each letter a-z (-1 if the maze has no such key) */
+int num_key_types;                  /**< Number of distinct key letters found in the maze */
+int held_keys;                      /**< Key mask collected by the player in manual mode */
+int heap_f[HEAP_SIZE];              /**< A* open list: f = g + h of each entry */
+int heap_g[HEAP_SIZE];              /**< A* open list: g of each entry */
+int heap_cell[HEAP_SIZE];           /**< A* open list: cell index of each entry */
+int heap_n;                         /**< Number of entries in the A* open list */
+int portal_bound[2 * MAX_PORTALS];  /**< Lower bound on the distance to 'E' after jumping through each portal end */
+int lpa_g[MAXR][MAXC];              /**< LPA* distance estimate g of each cell */
+int lpa_rhs[MAXR][MAXC];            /**< LPA* one-step lookahead rhs of each cell */
+int lpa_expanded;                   /**< Cells expanded by the last LPA* repair */
 const char* filename = "maze.txt";  /**< Path to the maze input file */
 /** @} */
 
@@ -82,6 +190,327 @@ void set_color(int color) {
 
 /** @} */
 
+/**
+ * @defgroup Threads Portable Worker Threads
+ * @{
+ */
+
+#ifdef _WIN32
+typedef HANDLE thread_t;
+typedef LPTHREAD_START_ROUTINE thread_func_t;
+#define THREAD_FUNC(name) DWORD WINAPI name(LPVOID arg)
+#define THREAD_RETURN return 0
+#else
+typedef pthread_t thread_t;
+typedef void* (*thread_func_t)(void*);
+#define THREAD_FUNC(name) void* name(void* arg)
+#define THREAD_RETURN return NULL
+#endif
+
+/**
+ * @brief Starts a worker thread.
+ * @param t Receives the thread handle
+ * @param fn Thread body declared with THREAD_FUNC
+ * @param arg Argument passed to the thread body
+ * @return 1 on success, 0 on failure
+ */
+int thread_start(thread_t* t, thread_func_t fn, void* arg) {
+#ifdef _WIN32
+    *t = CreateThread(NULL, 0, fn, arg, 0, NULL);
+    return *t != NULL;
+#else
+    return pthread_create(t, NULL, fn, arg) == 0;
+#endif
+}
+
+/**
+ * @brief Waits for a worker thread to finish and releases it.
+ * @param t Handle returned by thread_start
+ */
+void thread_join(thread_t t) {
+#ifdef _WIN32
+    WaitForSingleObject(t, INFINITE);
+    CloseHandle(t);
+#else
+    pthread_join(t, NULL);
+#endif
+}
+
+/**
+ * @brief Runs one thread per work item and waits for all of them.
+ * @details Items whose thread cannot be created are run on the calling thread instead.
+ * @param fn Thread body declared with THREAD_FUNC
+ * @param items Array of work items
+ * @param item_size Size in bytes of one work item
+ * @param n Number of work items (at most MAX_THREADS)
+ */
+void run_workers(thread_func_t fn, void* items, size_t item_size, int n) {
+    thread_t threads[MAX_THREADS];
+    int started[MAX_THREADS];
+    int i;
+    for (i = 0; i < n; i++) {
+        started[i] = thread_start(&threads[i], fn, (char*)items + i * item_size);
+    }
+    for (i = 0; i < n; i++) {
+        if (started[i]) thread_join(threads[i]);
+        else fn((char*)items + i * item_size);
+    }
+}
+
+/**
+ * @brief Returns the number of logical processors available to the program.
+ */
+int cpu_count(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+/**
+ * @brief Wall-clock time in seconds from an arbitrary origin (for timing other processes).
+ */
+double wall_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER now, freq;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&freq);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+#endif
+}
+
+/**
+ * @brief Chooses how many horizontal strips a row-parallel pass should use.
+ * @details One strip per processor, but never fewer than STRIP_ROWS rows per strip.
+ */
+int strip_count(void) {
+    int n = cpu_count();
+    if (n > rows / STRIP_ROWS) n = rows / STRIP_ROWS;
+    if (n > MAX_THREADS) n = MAX_THREADS;
+    if (n < 1) n = 1;
+    return n;
+}
+
+/**
+ * @brief Atomically replaces *p with desired if it still equals expected.
+ * @return 1 if the swap happened, 0 otherwise
+ */
+int atomic_cas_int(volatile int* p, int expected, int desired) {
+#ifdef _WIN32
+    return InterlockedCompareExchange((volatile LONG*)p, desired, expected) == expected;
+#else
+    return __sync_bool_compare_and_swap(p, expected, desired);
+#endif
+}
+
+/**
+ * @brief Atomically adds delta to *p.
+ * @return The value of *p before the addition
+ */
+int atomic_fetch_add_int(volatile int* p, int delta) {
+#ifdef _WIN32
+    return InterlockedExchangeAdd((volatile LONG*)p, delta);
+#else
+    return __sync_fetch_and_add(p, delta);
+#endif
+}
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION mutex_t;
+typedef CONDITION_VARIABLE cond_t;
+#else
+typedef pthread_mutex_t mutex_t;
+typedef pthread_cond_t cond_t;
+#endif
+
+/**
+ * @brief Initializes a mutex.
+ */
+void mutex_init(mutex_t* m) {
+#ifdef _WIN32
+    InitializeCriticalSection(m);
+#else
+    pthread_mutex_init(m, NULL);
+#endif
+}
+
+/**
+ * @brief Locks a mutex.
+ */
+void mutex_lock(mutex_t* m) {
+#ifdef _WIN32
+    EnterCriticalSection(m);
+#else
+    pthread_mutex_lock(m);
+#endif
+}
+
+/**
+ * @brief Unlocks a mutex.
+ */
+void mutex_unlock(mutex_t* m) {
+#ifdef _WIN32
+    LeaveCriticalSection(m);
+#else
+    pthread_mutex_unlock(m);
+#endif
+}
+
+/**
+ * @brief Releases a mutex.
+ */
+void mutex_destroy(mutex_t* m) {
+#ifdef _WIN32
+    DeleteCriticalSection(m);
+#else
+    pthread_mutex_destroy(m);
+#endif
+}
+
+/**
+ * @brief Initializes a condition variable.
+ */
+void cond_init(cond_t* c) {
+#ifdef _WIN32
+    InitializeConditionVariable(c);
+#else
+    pthread_cond_init(c, NULL);
+#endif
+}
+
+/**
+ * @brief Releases m, waits until c is signalled, then locks m again.
+ */
+void cond_wait(cond_t* c, mutex_t* m) {
+#ifdef _WIN32
+    SleepConditionVariableCS(c, m, INFINITE);
+#else
+    pthread_cond_wait(c, m);
+#endif
+}
+
+/**
+ * @brief Wakes one thread waiting on c.
+ */
+void cond_signal(cond_t* c) {
+#ifdef _WIN32
+    WakeConditionVariable(c);
+#else
+    pthread_cond_signal(c);
+#endif
+}
+
+/**
+ * @brief Wakes every thread waiting on c.
+ */
+void cond_broadcast(cond_t* c) {
+#ifdef _WIN32
+    WakeAllConditionVariable(c);
+#else
+    pthread_cond_broadcast(c);
+#endif
+}
+
+/**
+ * @brief Releases a condition variable.
+ */
+void cond_destroy(cond_t* c) {
+#ifdef _WIN32
+    (void)c;    // Windows condition variables need no cleanup
+#else
+    pthread_cond_destroy(c);
+#endif
+}
+
+/**
+ * @brief Fixed-capacity FIFO of pointers shared by producer and consumer threads.
+ * @details push blocks while the queue is full and pop while it is empty, so a
+ *          fast stage cannot run ahead of a slow one by more than the capacity.
+ */
+typedef struct {
+    void** slots;               /**< Ring buffer */
+    int capacity;               /**< Number of slots */
+    int head, count;            /**< Oldest item and number of items */
+    int closed;                 /**< Set once no more items will be pushed */
+    mutex_t lock;               /**< Guards every field */
+    cond_t not_empty, not_full; /**< Signalled by push and pop */
+} BoundedQueue;
+
+/**
+ * @brief Creates an empty queue with room for capacity items.
+ * @return 1 on success, 0 if out of memory
+ */
+int bqueue_init(BoundedQueue* q, int capacity) {
+    q->slots = (void**)malloc(sizeof(void*) * capacity);
+    q->capacity = capacity;
+    q->head = q->count = 0;
+    q->closed = 0;
+    mutex_init(&q->lock);
+    cond_init(&q->not_empty);
+    cond_init(&q->not_full);
+    return q->slots != NULL;
+}
+
+/**
+ * @brief Appends an item, waiting for room if the queue is full.
+ */
+void bqueue_push(BoundedQueue* q, void* item) {
+    mutex_lock(&q->lock);
+    while (q->count == q->capacity) cond_wait(&q->not_full, &q->lock);
+    q->slots[(q->head + q->count) % q->capacity] = item;
+    q->count++;
+    cond_signal(&q->not_empty);
+    mutex_unlock(&q->lock);
+}
+
+/**
+ * @brief Removes the oldest item, waiting for one if the queue is empty.
+ * @return The item, or NULL once the queue is closed and empty
+ */
+void* bqueue_pop(BoundedQueue* q) {
+    void* item = NULL;
+    mutex_lock(&q->lock);
+    while (q->count == 0 && !q->closed) cond_wait(&q->not_empty, &q->lock);
+    if (q->count > 0) {
+        item = q->slots[q->head];
+        q->head = (q->head + 1) % q->capacity;
+        q->count--;
+        cond_signal(&q->not_full);
+    }
+    mutex_unlock(&q->lock);
+    return item;
+}
+
+/**
+ * @brief Marks the queue closed and wakes every waiting consumer.
+ */
+void bqueue_close(BoundedQueue* q) {
+    mutex_lock(&q->lock);
+    q->closed = 1;
+    cond_broadcast(&q->not_empty);
+    mutex_unlock(&q->lock);
+}
+
+/**
+ * @brief Releases the queue (not the items still in it).
+ */
+void bqueue_destroy(BoundedQueue* q) {
+    free(q->slots);
+    mutex_destroy(&q->lock);
+    cond_destroy(&q->not_empty);
+    cond_destroy(&q->not_full);
+}
+
+/** @} */
+
 /**
  * @defgroup Queue BFS Queue Management
  * @{
@@ -128,320 +557,7041 @@ void queue_pop(int* r, int* c) {
 /** @} */
 
 /**
- * @defgroup MazeIO Maze File Loading & Validation
+ * @defgroup Topology Neighbour Expansion & Portals
  * @{
  */
 
  /**
-  * @brief Loads and validates the maze from the input text file.
-  * @details Reads line by line, removes trailing newline, ensures uniform row length,
-  *          and locates exactly one 'S' and one 'E'.
-  * @return 1 on success, 0 on failure (error message is printed)
+  * @brief Computes the cell one step away from (r, c) in direction d, without portals.
+  * @param r Row index
+  * @param c Column index
+  * @param d Direction index (0 to 3, as in dr/dc)
+  * @param nr Receives the row of the neighbour
+  * @param nc Receives the column of the neighbour
+  * @return 1 if the step stays inside or wraps around the maze, 0 otherwise
   */
-int load_maze(void) {
-    FILE* f = fopen(filename, "r");
-    if (f == NULL) {
-        set_color(RED);
-        printf("Error: maze.txt not found or cannot be opened!\n");
-        set_color(WHITE);
-        return 0;
-    }
+int step_cell(int r, int c, int d, int* nr, int* nc) {
+    *nr = next_row[d][r];
+    *nc = next_col[d][c];
+    return (*nr | *nc) >= 0;
+}
 
-    rows = 0;
-    char line[MAXC];
-    while (fgets(line, MAXC, f) != NULL) {
-        size_t len = strlen(line);
-        if (len > 0 && line[len - 1] == '\n') {
-            line[len - 1] = '\0';
-            len--;
-        }
-        if (len == 0) continue;
+/**
+ * @brief Computes the cell reached by move d from (r, c).
+ * @details A move is one step read from the successor tables. Stepping onto a portal
+ *          moves you to its partner as part of the same move, exactly as in manual
+ *          play, so a portal costs nothing extra and a path never rests on the end it
+ *          stepped onto. Walls are not checked.
+ * @param r Row index
+ * @param c Column index
+ * @param d Move index (0 to NUM_MOVES - 1)
+ * @param nr Receives the row of the cell the move ends on
+ * @param nc Receives the column of the cell the move ends on
+ * @return 1 if the move exists (stays inside or wraps around the maze), 0 otherwise
+ */
+int neighbor_cell(int r, int c, int d, int* nr, int* nc) {
+    int p;
+    if (!step_cell(r, c, d, nr, nc)) return 0;
+    p = portal_to[*nr][*nc];
+    if (p != -1) {
+        *nr = p / MAXC;
+        *nc = p % MAXC;
+    }
+    return 1;
+}
 
-        strcpy(maze[rows], line);
+/**
+ * @brief Computes the cell from which move d ends on (r, c); the inverse of neighbor_cell.
+ * @details A move only ends on a portal by stepping onto its partner, so for a portal
+ *          cell the step is undone from the partner. Walls are not checked.
+ * @return 1 if such a cell exists, 0 otherwise
+ */
+int prev_cell(int r, int c, int d, int* nr, int* nc) {
+    int p = portal_to[r][c];
+    if (p != -1) {
+        r = p / MAXC;
+        c = p % MAXC;
+    }
+    return step_cell(r, c, d ^ 1, nr, nc);
+}
 
-        if (rows == 0) {
-            cols = (int)len;
+/**
+ * @brief Fills the row/column successor tables used by step_cell.
+ * @details In a bounded maze, stepping off an edge yields -1; with wrap_mode the
+ *          step re-enters from the opposite edge. Either way the hot loops only do
+ *          table lookups, with no bounds checks or modulo.
+ */
+void build_successor_tables(void) {
+    int d, i;
+    for (d = 0; d < 4; d++) {
+        for (i = 0; i < rows; i++) {
+            int n = i + dr[d];
+            if (n < 0 || n >= rows) n = wrap_mode ? (n + rows) % rows : -1;
+            next_row[d][i] = n;
         }
-        else if ((int)len != cols) {
-            set_color(RED);
-            printf("Error: All rows must have the same length!\n");
-            set_color(WHITE);
-            fclose(f);
-            return 0;
+        for (i = 0; i < cols; i++) {
+            int n = i + dc[d];
+            if (n < 0 || n >= cols) n = wrap_mode ? (n + cols) % cols : -1;
+            next_col[d][i] = n;
         }
+    }
+}
 
-        rows++;
-        if (rows >= MAXR) break;
+/** @} */
+
+/**
+ * @defgroup DynConn Dynamic Connectivity Under Wall Edits
+ * @{
+ */
+
+ /**
+  * @brief Node of an Euler-tour treap: a cell, or one direction of a spanning-forest edge.
+  * @details Trees are kept in implicit-key treaps (ordered by tour position), so a
+  *          tour can be split and joined in O(log n). flag marks cells that have
+  *          non-tree edges (bit 0) or tree edges (bit 1) on the node's level; agg is
+  *          the OR over the subtree, used to find such cells quickly.
+  */
+typedef struct {
+    int left, right, parent;    /**< Treap links (-1 if none) */
+    unsigned int prio;          /**< Random heap priority */
+    int cnt;                    /**< Number of nodes in the subtree */
+    unsigned char flag, agg;    /**< Own flags and OR of the subtree's flags */
+} ConnNode;
+
+/*
+ * Level-structured spanning forest (Holm, de Lichtenberg & Thorup): every edge has
+ * a level; forest i holds the tree edges of level >= i. A deleted tree edge is
+ * replaced by searching only the smaller half, and every edge examined without
+ * success moves up a level, so each edge is touched at most CONN_LEVELS times.
+ */
+ConnNode conn_node[CONN_LEVELS * QSIZE * 3];    /**< Cell nodes of each level, then pairs of edge nodes */
+int conn_free[CONN_LEVELS * QSIZE];             /**< Stack of unused edge node pairs */
+int conn_nfree;                                 /**< Number of entries in conn_free */
+signed char edge_level[CONN_EDGES];             /**< Level of each edge (-1 if absent) */
+unsigned char edge_tree[CONN_EDGES];            /**< 1 if the edge is in the spanning forest */
+int edge_arcs[CONN_LEVELS][CONN_EDGES];         /**< Edge node pair of each tree edge on each level */
+unsigned char nontree_deg[CONN_LEVELS][QSIZE];  /**< Non-tree edges of each cell on each level */
+unsigned char tree_deg[CONN_LEVELS][QSIZE];     /**< Tree edges of each cell whose level is exactly this one */
+
+/**
+ * @brief Node count of a treap (0 for -1).
+ */
+int cn_cnt(int x) {
+    return x == -1 ? 0 : conn_node[x].cnt;
+}
+
+/**
+ * @brief Recomputes the size and flag aggregate of x from its children.
+ */
+void cn_pull(int x) {
+    ConnNode* n = &conn_node[x];
+    n->cnt = 1 + cn_cnt(n->left) + cn_cnt(n->right);
+    n->agg = n->flag;
+    if (n->left != -1) {
+        n->agg |= conn_node[n->left].agg;
+        conn_node[n->left].parent = x;
     }
-    fclose(f);
+    if (n->right != -1) {
+        n->agg |= conn_node[n->right].agg;
+        conn_node[n->right].parent = x;
+    }
+}
 
-    if (rows == 0 || cols == 0) {
-        set_color(RED);
-        printf("Maze is empty!\n");
-        set_color(WHITE);
-        return 0;
+/**
+ * @brief Concatenates two treaps.
+ */
+int cn_merge(int a, int b) {
+    if (a == -1) return b;
+    if (b == -1) return a;
+    if (conn_node[a].prio > conn_node[b].prio) {
+        conn_node[a].right = cn_merge(conn_node[a].right, b);
+        cn_pull(a);
+        conn_node[a].parent = -1;
+        return a;
     }
+    conn_node[b].left = cn_merge(a, conn_node[b].left);
+    cn_pull(b);
+    conn_node[b].parent = -1;
+    return b;
+}
 
-    sr = sc = er = ec = -1;
-    int i, j;
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            if (maze[i][j] == 'S') { sr = i; sc = j; }
-            if (maze[i][j] == 'E') { er = i; ec = j; }
+/**
+ * @brief Splits a treap into its first k nodes and the rest.
+ */
+void cn_split(int t, int k, int* a, int* b) {
+    if (t == -1) {
+        *a = *b = -1;
+        return;
+    }
+    if (cn_cnt(conn_node[t].left) >= k) {
+        cn_split(conn_node[t].left, k, a, &conn_node[t].left);
+        cn_pull(t);
+        *b = t;
+    }
+    else {
+        cn_split(conn_node[t].right, k - cn_cnt(conn_node[t].left) - 1, &conn_node[t].right, b);
+        cn_pull(t);
+        *a = t;
+    }
+    if (*a != -1) conn_node[*a].parent = -1;
+    if (*b != -1) conn_node[*b].parent = -1;
+}
+
+/**
+ * @brief Root of the treap holding node x (identifies the tree of a cell).
+ */
+int cn_root(int x) {
+    while (conn_node[x].parent != -1) x = conn_node[x].parent;
+    return x;
+}
+
+/**
+ * @brief Position of node x in its Euler tour.
+ */
+int cn_index(int x) {
+    int idx = cn_cnt(conn_node[x].left);
+    while (conn_node[x].parent != -1) {
+        int p = conn_node[x].parent;
+        if (conn_node[p].right == x) idx += cn_cnt(conn_node[p].left) + 1;
+        x = p;
+    }
+    return idx;
+}
+
+/**
+ * @brief Rotates the tour of x's tree so that it starts at x; returns the new root.
+ */
+int cn_reroot(int x) {
+    int a, b;
+    cn_split(cn_root(x), cn_index(x), &a, &b);
+    return cn_merge(b, a);
+}
+
+/**
+ * @brief Resets node x to a single-node treap without flags.
+ */
+void cn_init(int x) {
+    ConnNode* n = &conn_node[x];
+    n->left = n->right = n->parent = -1;
+    n->prio = ((unsigned int)rand() << 16) ^ (unsigned int)rand();
+    n->cnt = 1;
+    n->flag = n->agg = 0;
+}
+
+/**
+ * @brief Node of cell v on a level.
+ */
+int cn_cell(int level, int v) {
+    return level * QSIZE + v;
+}
+
+/**
+ * @brief Recomputes the flags of cell v on a level and propagates them to the root.
+ */
+void cn_refresh(int level, int v) {
+    int x = cn_cell(level, v);
+    conn_node[x].flag = (nontree_deg[level][v] > 0) | (tree_deg[level][v] > 0) << 1;
+    while (x != -1) {
+        cn_pull(x);
+        x = conn_node[x].parent;
+    }
+}
+
+/**
+ * @brief Finds a node with the given flag bit in a treap (-1 if none).
+ */
+int cn_find_flag(int t, unsigned char bit) {
+    while (t != -1 && (conn_node[t].agg & bit)) {
+        if (conn_node[t].left != -1 && (conn_node[conn_node[t].left].agg & bit)) t = conn_node[t].left;
+        else if (conn_node[t].flag & bit) return t;
+        else t = conn_node[t].right;
+    }
+    return -1;
+}
+
+/**
+ * @brief Joins the trees of u and v on a level with tree edge e.
+ */
+void cn_link(int level, int u, int v, int e) {
+    int pair = conn_free[--conn_nfree];
+    int x = CONN_LEVELS * QSIZE + 2 * pair;
+    cn_init(x);
+    cn_init(x + 1);
+    edge_arcs[level][e] = pair;
+
+    int tu = cn_reroot(cn_cell(level, u));
+    int tv = cn_reroot(cn_cell(level, v));
+    cn_merge(cn_merge(cn_merge(tu, x), tv), x + 1);
+}
+
+/**
+ * @brief Removes tree edge e from the forest of a level, splitting its tree in two.
+ */
+void cn_cut(int level, int e) {
+    int pair = edge_arcs[level][e];
+    int x = CONN_LEVELS * QSIZE + 2 * pair, y = x + 1;
+    int ix = cn_index(x), iy = cn_index(y);
+    int head, mid, tail, tmp;
+
+    if (ix > iy) {
+        tmp = ix; ix = iy; iy = tmp;
+    }
+    // tour = head, arc, mid, arc, tail: mid is one tree, head + tail the other
+    cn_split(cn_root(x), iy + 1, &head, &tail);
+    cn_split(head, iy, &head, &tmp);
+    cn_split(head, ix + 1, &head, &mid);
+    cn_split(head, ix, &head, &tmp);
+    cn_merge(head, tail);
+    conn_free[conn_nfree++] = pair;
+}
+
+/**
+ * @brief Tells whether cells u and v are connected in the forest of a level.
+ */
+int cn_connected(int level, int u, int v) {
+    return cn_root(cn_cell(level, u)) == cn_root(cn_cell(level, v));
+}
+
+/**
+ * @brief Identifies the edge leaving cell v by link d.
+ * @details Links 0-3 are plain steps and link 4 joins a portal to its partner. A move
+ *          through a portal is a step followed by that link, so both give the same
+ *          connectivity. Each edge is owned by one of its ends: the upper cell for
+ *          vertical edges, the left cell for horizontal ones and the lower index for
+ *          portal links.
+ * @param w Receives the other end
+ * @return Edge slot, or -1 if the link does not exist or leads back to v
+ */
+int conn_edge_id(int v, int d, int* w) {
+    int nr, nc;
+    if (d == 4) {
+        *w = portal_to[v / MAXC][v % MAXC];
+        if (*w == -1) return -1;
+    }
+    else {
+        if (!step_cell(v / MAXC, v % MAXC, d, &nr, &nc)) return -1;
+        *w = nr * MAXC + nc;
+    }
+    if (*w == v) return -1;
+    if (d == 0) return *w * 3;
+    if (d == 1) return v * 3;
+    if (d == 2) return *w * 3 + 1;
+    if (d == 3) return v * 3 + 1;
+    return (v < *w ? v : *w) * 3 + 2;
+}
+
+/**
+ * @brief Updates the per-level degree of both ends of an edge and refreshes their flags.
+ */
+void conn_count(unsigned char deg[CONN_LEVELS][QSIZE], int level, int u, int w, int delta) {
+    deg[level][u] += delta;
+    deg[level][w] += delta;
+    cn_refresh(level, u);
+    cn_refresh(level, w);
+}
+
+/**
+ * @brief Inserts edge e = (u, w) on level 0, as a tree edge if it joins two trees.
+ */
+void conn_insert(int e, int u, int w) {
+    edge_level[e] = 0;
+    edge_tree[e] = !cn_connected(0, u, w);
+    if (edge_tree[e]) {
+        cn_link(0, u, w, e);
+        conn_count(tree_deg, 0, u, w, 1);
+    }
+    else {
+        conn_count(nontree_deg, 0, u, w, 1);
+    }
+}
+
+/**
+ * @brief After a tree edge between u and w was cut, looks for a replacement on one level.
+ * @details The smaller of the two halves is searched: its tree edges of this level
+ *          move up a level first, then its non-tree edges are tried one by one. An
+ *          edge leading to the other half reconnects the trees; any other moves up.
+ * @return 1 if a replacement edge was found
+ */
+int conn_replace(int level, int u, int w) {
+    int ru = cn_root(cn_cell(level, u)), rw = cn_root(cn_cell(level, w));
+    int small = cn_cnt(ru) <= cn_cnt(rw) ? ru : rw;
+    int x, d;
+
+    while ((x = cn_find_flag(small, 2)) != -1) {
+        int v = x % QSIZE;
+        for (d = 0; d < NUM_LINKS; d++) {
+            int y, e = conn_edge_id(v, d, &y);
+            if (e == -1 || !edge_tree[e] || edge_level[e] != level) continue;
+            edge_level[e] = level + 1;
+            conn_count(tree_deg, level, v, y, -1);
+            conn_count(tree_deg, level + 1, v, y, 1);
+            cn_link(level + 1, v, y, e);
+        }
+    }
+
+    while ((x = cn_find_flag(small, 1)) != -1) {
+        int v = x % QSIZE;
+        for (d = 0; d < NUM_LINKS; d++) {
+            int y, e = conn_edge_id(v, d, &y);
+            if (e == -1 || edge_tree[e] || edge_level[e] != level) continue;
+            conn_count(nontree_deg, level, v, y, -1);
+            if (cn_root(cn_cell(level, y)) != small) {
+                int i;
+                edge_tree[e] = 1;
+                conn_count(tree_deg, level, v, y, 1);
+                for (i = 0; i <= level; i++) cn_link(i, v, y, e);
+                return 1;
+            }
+            edge_level[e] = level + 1;
+            conn_count(nontree_deg, level + 1, v, y, 1);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Deletes edge e = (u, w), repairing the spanning forest if it was a tree edge.
+ */
+void conn_delete(int e, int u, int w) {
+    int level = edge_level[e], i;
+    edge_level[e] = -1;
+    if (!edge_tree[e]) {
+        conn_count(nontree_deg, level, u, w, -1);
+        return;
+    }
+
+    edge_tree[e] = 0;
+    conn_count(tree_deg, level, u, w, -1);
+    for (i = 0; i <= level; i++) cn_cut(i, e);
+    for (i = level; i >= 0; i--) {
+        if (conn_replace(i, u, w)) break;
+    }
+}
+
+/**
+ * @brief Builds the connectivity forest for the loaded maze.
+ */
+void conn_build(void) {
+    int level, i, j, d;
+    for (level = 0; level < CONN_LEVELS; level++) {
+        for (i = 0; i < rows; i++) {
+            for (j = 0; j < cols; j++) {
+                cn_init(cn_cell(level, i * MAXC + j));
+                nontree_deg[level][i * MAXC + j] = 0;
+                tree_deg[level][i * MAXC + j] = 0;
+            }
+        }
+    }
+    for (i = 0; i < CONN_EDGES; i++) edge_level[i] = -1;
+    conn_nfree = 0;
+    for (i = CONN_LEVELS * QSIZE - 1; i >= 0; i--) conn_free[conn_nfree++] = i;
+
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            if (maze[i][j] == '#') continue;
+            for (d = 0; d < NUM_LINKS; d++) {
+                int w, e = conn_edge_id(i * MAXC + j, d, &w);
+                if (e == -1 || edge_level[e] != -1 || maze[w / MAXC][w % MAXC] == '#') continue;
+                conn_insert(e, i * MAXC + j, w);
+            }
+        }
+    }
+    conn_ready = 1;
+}
+
+/**
+ * @brief Tells whether two cells are connected, in O(log n) from the forest.
+ */
+int conn_connected(int r1, int c1, int r2, int c2) {
+    if (maze[r1][c1] == '#' || maze[r2][c2] == '#') return 0;
+    if (!conn_ready) conn_build();
+    return cn_connected(0, r1 * MAXC + c1, r2 * MAXC + c2);
+}
+
+/**
+ * @brief Editing API: turns a wall into an open cell or an open cell into a wall.
+ * @details Only '#', '*' and ' ' cells can be edited. The edges of the cell are
+ *          inserted into or deleted from the connectivity forest, and the load-time
+ *          component labels are marked stale.
+ * @param r Row of the cell
+ * @param c Column of the cell
+ * @return 1 if the cell was changed, 0 if it cannot be edited
+ */
+int flip_wall(int r, int c) {
+    int v = r * MAXC + c, d;
+    if (r < 0 || r >= rows || c < 0 || c >= cols) return 0;
+    if (maze[r][c] != '#' && maze[r][c] != '*' && maze[r][c] != ' ') return 0;
+    if (!conn_ready) conn_build();
+
+    maze[r][c] = maze[r][c] == '#' ? '*' : '#';
+    labels_stale = 1;
+    maze_hash_stale = 1;
+    for (d = 0; d < NUM_LINKS; d++) {
+        int w, e = conn_edge_id(v, d, &w);
+        if (e == -1) continue;
+        if (maze[r][c] == '#' && edge_level[e] != -1) conn_delete(e, v, w);
+        else if (maze[r][c] != '#' && edge_level[e] == -1 && maze[w / MAXC][w % MAXC] != '#') conn_insert(e, v, w);
+    }
+    return 1;
+}
+
+/** @} */
+
+/**
+ * @defgroup Components Connected-Component Labeling
+ * @{
+ */
+
+ /**
+  * @brief Finds the union-find root of a cell, halving the path on the way.
+  * @param x Cell index (r * MAXC + c)
+  * @return Index of the root cell of x's component
+  */
+int uf_find(int x) {
+    while (uf_parent[x] != x) {
+        uf_parent[x] = uf_parent[uf_parent[x]];
+        x = uf_parent[x];
+    }
+    return x;
+}
+
+/**
+ * @brief Finds the union-find root of a cell without modifying any links.
+ * @details Safe to call while other threads are linking roots.
+ * @param x Cell index (r * MAXC + c)
+ * @return Index of the root cell of x's component
+ */
+int uf_root(int x) {
+    volatile int* parent = uf_parent;
+    int p;
+    while ((p = parent[x]) != x) {
+        x = p;
+    }
+    return x;
+}
+
+/**
+ * @brief Merges the components of two cells (lock-free).
+ * @details The larger root is linked under the smaller one with a compare-and-swap;
+ *          if another thread re-linked it first, the roots are looked up again.
+ *          Labels are therefore deterministic regardless of thread timing.
+ * @param a Cell index of the first cell
+ * @param b Cell index of the second cell
+ */
+void uf_union(int a, int b) {
+    while (1) {
+        a = uf_root(a);
+        b = uf_root(b);
+        if (a == b) return;
+        if (a < b) {
+            int t = a;
+            a = b;
+            b = t;
+        }
+        if (atomic_cas_int(&uf_parent[a], a, b)) return;
+    }
+}
+
+/**
+ * @brief Splits the rows [r0, r1) into runs of open cells and links each run to itself.
+ * @details Every cell of a run points at the run's first cell. Rows are independent,
+ *          so any set of row strips can be processed separately.
+ * @param r0 First row of the strip
+ * @param r1 One past the last row of the strip
+ */
+void label_runs(int r0, int r1) {
+    int r, c;
+    for (r = r0; r < r1; r++) {
+        run_count[r] = 0;
+        c = 0;
+        while (c < cols) {
+            if (maze[r][c] == '#') {
+                uf_parent[r * MAXC + c] = r * MAXC + c;
+                c++;
+                continue;
+            }
+            int head = r * MAXC + c;
+            run_start[r][run_count[r]] = c;
+            while (c < cols && maze[r][c] != '#') {
+                uf_parent[r * MAXC + c] = head;
+                c++;
+            }
+            run_end[r][run_count[r]] = c - 1;
+            run_count[r]++;
+        }
+    }
+}
+
+/**
+ * @brief Unions every run of row b with the runs of row a it touches.
+ * @details Both run lists are sorted by column, so a single two-pointer sweep suffices.
+ * @param a Index of the first row
+ * @param b Index of the second row
+ */
+void merge_row_pair(int a, int b) {
+    int i = 0, j = 0;
+    while (i < run_count[a] && j < run_count[b]) {
+        if (run_end[a][i] >= run_start[b][j] && run_end[b][j] >= run_start[a][i]) {
+            uf_union(a * MAXC + run_start[a][i], b * MAXC + run_start[b][j]);
+        }
+        if (run_end[a][i] < run_end[b][j]) i++;
+        else j++;
+    }
+}
+
+/**
+ * @brief Unions every run of row r with the runs of row r - 1 it touches.
+ * @param r Row index (must be at least 1)
+ */
+void merge_rows(int r) {
+    merge_row_pair(r - 1, r);
+}
+
+/**
+ * @brief Joins the regions connected by wrap-around edges and portal pairs.
+ * @details Runs once, after the strips are merged: row 0 is glued to the last row,
+ *          and the first and last cells of each row are joined when both are open.
+ */
+void join_extra_edges(void) {
+    int i;
+    if (wrap_mode) {
+        if (rows > 1) merge_row_pair(rows - 1, 0);
+        for (i = 0; i < rows; i++) {
+            if (cols > 1 && maze[i][0] != '#' && maze[i][cols - 1] != '#') {
+                uf_union(i * MAXC, i * MAXC + cols - 1);
+            }
+        }
+    }
+    for (i = 0; i < num_portals; i++) {
+        uf_union(portal_a[i], portal_b[i]);
+    }
+}
+
+/**
+ * @brief Work description for one strip of the parallel labeling.
+ */
+typedef struct {
+    int r0, r1;         /**< Rows [r0, r1) owned by the strip */
+    int components;     /**< Number of roots found in the strip (final phase) */
+} LabelStrip;
+
+/**
+ * @brief Phase 1: labels runs inside a strip and merges the strip's own row pairs.
+ * @details Only cells of the strip are touched, so strips never contend.
+ */
+THREAD_FUNC(label_strip_worker) {
+    LabelStrip* strip = (LabelStrip*)arg;
+    int r;
+    label_runs(strip->r0, strip->r1);
+    for (r = strip->r0 + 1; r < strip->r1; r++) {
+        merge_rows(r);
+    }
+    THREAD_RETURN;
+}
+
+/**
+ * @brief Phase 2: merges the first row of a strip with the last row of the strip above.
+ */
+THREAD_FUNC(label_boundary_worker) {
+    LabelStrip* strip = (LabelStrip*)arg;
+    merge_rows(strip->r0);
+    THREAD_RETURN;
+}
+
+/**
+ * @brief Phase 3: points every cell of the strip straight at its root and counts roots.
+ */
+THREAD_FUNC(label_flatten_worker) {
+    LabelStrip* strip = (LabelStrip*)arg;
+    int r, c;
+    strip->components = 0;
+    for (r = strip->r0; r < strip->r1; r++) {
+        for (c = 0; c < cols; c++) {
+            int x = r * MAXC + c;
+            int root = uf_root(x);
+            uf_parent[x] = root;
+            if (root == x && maze[r][c] != '#') strip->components++;
+        }
+    }
+    THREAD_RETURN;
+}
+
+/**
+ * @brief Labels the connected open regions of the loaded maze.
+ * @details Run-based union-find over horizontal strips of rows. Each strip is
+ *          labeled by its own thread, the strip boundaries are then merged in
+ *          parallel with the lock-free uf_union, and a final pass flattens the
+ *          links. Wrap-around edges and portal pairs are joined before flattening.
+ *          Small mazes use a single strip on the calling thread.
+ *          Afterwards every reachability question is a comparison of two roots.
+ */
+void label_components(void) {
+    LabelStrip strips[MAX_THREADS];
+    int nstrips = strip_count();
+    int i;
+
+    for (i = 0; i < nstrips; i++) {
+        strips[i].r0 = rows * i / nstrips;
+        strips[i].r1 = rows * (i + 1) / nstrips;
+    }
+
+    if (nstrips == 1) {
+        label_strip_worker(&strips[0]);
+        join_extra_edges();
+        label_flatten_worker(&strips[0]);
+        num_components = strips[0].components;
+        labels_stale = 0;
+        return;
+    }
+
+    run_workers(label_strip_worker, strips, sizeof(LabelStrip), nstrips);
+    run_workers(label_boundary_worker, strips + 1, sizeof(LabelStrip), nstrips - 1);
+    join_extra_edges();
+    run_workers(label_flatten_worker, strips, sizeof(LabelStrip), nstrips);
+
+    num_components = 0;
+    for (i = 0; i < nstrips; i++) {
+        num_components += strips[i].components;
+    }
+    labels_stale = 0;
+}
+
+/**
+ * @brief Checks whether two cells lie in the same connected open region.
+ * @return 1 if a path between the cells exists, 0 otherwise (or if either is a wall).
+ *         After wall edits the labels are stale and the dynamic forest answers instead.
+ */
+int same_component(int r1, int c1, int r2, int c2) {
+    if (maze[r1][c1] == '#' || maze[r2][c2] == '#') return 0;
+    if (labels_stale) return conn_connected(r1, c1, r2, c2);    // edited since labeling
+    return uf_find(r1 * MAXC + c1) == uf_find(r2 * MAXC + c2);
+}
+
+/** @} */
+
+/**
+ * @defgroup Cache Content-Addressed Solution Cache
+ * @{
+ */
+
+#define CACHE_BFS           1       /**< Algorithm id: path found by bfs_shortest */
+#define CACHE_BATCH         2       /**< Algorithm id: result of the batch solver */
+
+/**
+ * @brief Letter of each move (indexed by direction) in cached paths.
+ */
+const char move_letters[] = "UDLR";
+
+/**
+ * @brief Maps a whole file read-only into memory.
+ * @param path File to map
+ * @param size Receives the file size
+ * @return Pointer to the mapped bytes, or NULL on failure
+ */
+const char* map_file(const char* path, size_t* size) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return NULL;
+    LARGE_INTEGER len;
+    GetFileSizeEx(file, &len);
+    *size = (size_t)len.QuadPart;
+    HANDLE mapping = *size ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    CloseHandle(file);
+    if (mapping == NULL) return NULL;
+    const char* data = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0) return NULL;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+    *size = (size_t)st.st_size;
+    void* data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    return data == MAP_FAILED ? NULL : (const char*)data;
+#endif
+}
+
+/**
+ * @brief Releases a mapping created by map_file.
+ */
+void unmap_file(const char* data, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(data);
+#else
+    munmap((void*)data, size);
+#endif
+}
+
+/**
+ * @brief Reads a little-endian 64-bit word.
+ */
+unsigned long long load_le64(const unsigned char* p) {
+    unsigned long long v = 0;
+    int i;
+    for (i = 7; i >= 0; i--) v = v << 8 | p[i];
+    return v;
+}
+
+/**
+ * @brief Hashes a buffer whose length is a multiple of 16 bytes.
+ * @details Two 64-bit accumulators each take one half of every 16-byte block: the
+ *          half is XORed with a key that changes per block, its 32-bit halves are
+ *          multiplied together and added, and the other half is added as well.
+ *          SSE2 does both accumulators in one instruction; the scalar loop gives
+ *          the same value, so cache files work with either build.
+ */
+unsigned long long hash_blocks(const unsigned char* data, size_t len) {
+    const unsigned long long key0 = 0xBE4BA423396CFEB8ULL, key1 = 0x1CAD21F72C81017CULL, step = 0x9E3779B97F4A7C15ULL;
+    unsigned long long acc[2], h;
+    size_t i;
+#ifdef HAVE_SSE2
+    __m128i sum = _mm_set_epi64x(0x85EBCA77C2B2AE63LL, 0x27D4EB2F165667C5LL);
+    __m128i key = _mm_set_epi64x((long long)key1, (long long)key0);
+    __m128i inc = _mm_set1_epi64x((long long)step);
+    for (i = 0; i < len; i += 16) {
+        __m128i d = _mm_loadu_si128((const __m128i*)(data + i));
+        __m128i dk = _mm_xor_si128(d, key);
+        sum = _mm_add_epi64(sum, _mm_mul_epu32(dk, _mm_srli_epi64(dk, 32)));
+        sum = _mm_add_epi64(sum, _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+        key = _mm_add_epi64(key, inc);
+    }
+    _mm_storeu_si128((__m128i*)acc, sum);
+#else
+    unsigned long long k0 = key0, k1 = key1;
+    acc[0] = 0x27D4EB2F165667C5ULL;
+    acc[1] = 0x85EBCA77C2B2AE63ULL;
+    for (i = 0; i < len; i += 16) {
+        unsigned long long d0 = load_le64(data + i), d1 = load_le64(data + i + 8);
+        unsigned long long x0 = d0 ^ k0, x1 = d1 ^ k1;
+        acc[0] += (x0 & 0xFFFFFFFFULL) * (x0 >> 32) + d1;
+        acc[1] += (x1 & 0xFFFFFFFFULL) * (x1 >> 32) + d0;
+        k0 += step;
+        k1 += step;
+    }
+#endif
+    h = acc[0] ^ (acc[1] << 29 | acc[1] >> 35) ^ (unsigned long long)len * step;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @brief Content hash of a maze: its cells, size, wrap-around, 'S' and 'E'.
+ * @details Everything the shortest path depends on, so equal hashes mean the
+ *          cached path applies (up to a 64-bit collision).
+ */
+unsigned long long grid_hash(const char cells[MAXR][MAXC], int rows, int cols, int sr, int sc, int er, int ec, int wrap) {
+    unsigned char buf[32 + MAXR * MAXC + 16];
+    int header[8] = { rows, cols, sr, sc, er, ec, wrap, 0 };
+    size_t n = 0;
+    int i, b;
+
+    for (i = 0; i < 8; i++) {
+        for (b = 0; b < 4; b++) buf[n++] = (unsigned char)((unsigned int)header[i] >> (8 * b));
+    }
+    for (i = 0; i < rows; i++) {
+        memcpy(buf + n, cells[i], cols);
+        n += cols;
+    }
+    while (n % 16 != 0) buf[n++] = 0;
+    return hash_blocks(buf, n);
+}
+
+/**
+ * @brief Hash of the loaded maze, recomputed if walls were edited since load_maze.
+ */
+unsigned long long current_maze_hash(void) {
+    if (maze_hash_stale) {
+        maze_hash = grid_hash((const char(*)[MAXC])maze, rows, cols, sr, sc, er, ec, wrap_mode);
+        maze_hash_stale = 0;
+    }
+    return maze_hash;
+}
+
+/**
+ * @brief A cached result; on disk it is followed by its move string.
+ */
+typedef struct {
+    unsigned long long hash;        /**< grid_hash of the maze */
+    int algo;                       /**< CACHE_ id of the algorithm */
+    int rows, cols;                 /**< Maze size (checked on lookup) */
+    int sr, sc, er, ec;             /**< Start and exit (checked on lookup) */
+    int length;                     /**< Path length (-1 if there is no path) */
+    int reached;                    /**< Cells reachable from 'S' (-1 if not recorded) */
+    int moves;                      /**< Length of the move string (see move_letters) */
+} CacheRecord;
+
+/**
+ * @brief Slot of the in-memory index of the on-disk records.
+ */
+typedef struct {
+    unsigned long long hash;        /**< Key hash */
+    int algo;                       /**< Key algorithm (0 marks an empty slot) */
+    size_t offset;                  /**< File offset of the record */
+} CacheSlot;
+
+/**
+ * @brief Entry of the in-memory tier.
+ */
+typedef struct {
+    CacheRecord rec;                /**< The result (rec.algo is 0 if the entry is unused) */
+    char* moves;                    /**< Its move string */
+    int newer, older;               /**< Neighbours in the recency list (-1 at either end) */
+    int chain;                      /**< Next entry in the same hash bucket (-1 at the end) */
+} CacheEntry;
+
+/**
+ * @brief Two-tier solution cache: recent results in memory, all results in CACHE_FILE.
+ * @details The file is a header followed by appended records. It is mapped read-only
+ *          and indexed by (hash, algorithm) when the batch mode opens it. New records collect in a
+ *          pending buffer that is written CACHE_FLUSH_RECORDS at a time and by
+ *          cache_flush; records written later are read by remapping the file. The
+ *          in-memory tier is found through hash buckets and evicted from the tail of
+ *          a recency list, so no operation scans it.
+ */
+typedef struct {
+    int opened;                     /**< 1 once cache_init ran */
+    int file_opened;                /**< 1 once cache_open ran */
+    FILE* out;                      /**< CACHE_FILE open for appending (NULL if it cannot be written) */
+    const char* map;                /**< Mapped file (NULL if empty or missing) */
+    size_t map_size;                /**< Bytes mapped */
+    size_t file_size;               /**< Bytes of valid records, including those still pending */
+    size_t written;                 /**< Bytes written to the file; the pending buffer starts here */
+    char* pending;                  /**< Records not yet written */
+    size_t pending_len, pending_cap; /**< Bytes used and allocated in pending */
+    int pending_records;            /**< Records in pending */
+    CacheSlot* slots;               /**< Open-addressing index of the records */
+    int slot_count, slot_used;      /**< Capacity (a power of two) and entries of the index */
+    CacheEntry lru[CACHE_LRU_ENTRIES]; /**< In-memory tier */
+    int lru_bucket[CACHE_LRU_BUCKETS]; /**< First entry of each hash bucket (-1 if empty) */
+    int lru_newest, lru_oldest;     /**< Ends of the recency list (-1 if empty) */
+    int lru_count;                  /**< Entries of lru in use */
+    mutex_t lock;                   /**< Serializes every cache operation */
+} SolutionCache;
+
+SolutionCache solution_cache;       /**< The cache shared by every solver */
+
+/**
+ * @brief Finds the index slot of a key, or the empty slot where it belongs.
+ */
+CacheSlot* cache_slot(unsigned long long hash, int algo) {
+    SolutionCache* sc = &solution_cache;
+    int i = (int)(hash ^ (unsigned long long)algo * 0x9E3779B97F4A7C15ULL) & (sc->slot_count - 1);
+    while (sc->slots[i].algo != 0 && (sc->slots[i].hash != hash || sc->slots[i].algo != algo)) {
+        i = (i + 1) & (sc->slot_count - 1);
+    }
+    return &sc->slots[i];
+}
+
+/**
+ * @brief Adds a record to the index, doubling it when it is 70% full.
+ * @return 1 on success, 0 if the index could not grow
+ */
+int cache_index(unsigned long long hash, int algo, size_t offset) {
+    SolutionCache* sc = &solution_cache;
+    CacheSlot* slot;
+    int i;
+
+    if ((sc->slot_used + 1) * 10 > sc->slot_count * 7) {
+        CacheSlot* old = sc->slots;
+        int old_count = sc->slot_count;
+        CacheSlot* grown = (CacheSlot*)calloc(old_count ? old_count * 2 : 1024, sizeof(CacheSlot));
+        if (grown == NULL) return 0;
+        sc->slots = grown;
+        sc->slot_count = old_count ? old_count * 2 : 1024;
+        for (i = 0; i < old_count; i++) {
+            if (old[i].algo != 0) *cache_slot(old[i].hash, old[i].algo) = old[i];
+        }
+        free(old);
+    }
+    slot = cache_slot(hash, algo);
+    if (slot->algo == 0) sc->slot_used++;
+    slot->hash = hash;
+    slot->algo = algo;
+    slot->offset = offset;
+    return 1;
+}
+
+/**
+ * @brief Turns the on-disk tier off; the in-memory tier keeps working.
+ * @details Used when the index of the file cannot grow, since a full index could
+ *          not be probed. Records not written yet are dropped.
+ */
+void cache_drop_file(void) {
+    SolutionCache* sc = &solution_cache;
+    if (sc->out != NULL) fclose(sc->out);
+    sc->out = NULL;
+    if (sc->map != NULL) unmap_file(sc->map, sc->map_size);
+    sc->map = NULL;
+    sc->map_size = 0;
+    free(sc->slots);
+    sc->slots = NULL;
+    sc->slot_count = sc->slot_used = 0;
+    sc->pending_len = 0;
+    sc->pending_records = 0;
+    sc->file_size = sc->written;
+}
+
+/**
+ * @brief Sets up the in-memory tier on first use.
+ * @details Must first be called before solver threads use the cache.
+ */
+void cache_init(void) {
+    SolutionCache* sc = &solution_cache;
+    int i;
+
+    if (sc->opened) return;
+    sc->opened = 1;
+    mutex_init(&sc->lock);
+    for (i = 0; i < CACHE_LRU_BUCKETS; i++) sc->lru_bucket[i] = -1;
+    for (i = 0; i < CACHE_LRU_ENTRIES; i++) sc->lru[i].newer = sc->lru[i].older = sc->lru[i].chain = -1;
+    sc->lru_newest = sc->lru_oldest = -1;
+}
+
+/**
+ * @brief Maps and indexes CACHE_FILE (creating it if needed) so results persist.
+ * @details Only the batch mode calls this; until then the cache lives in memory and
+ *          nothing is written to the working directory. Must be called before solver
+ *          threads use the cache.
+ */
+void cache_open(void) {
+    SolutionCache* sc = &solution_cache;
+    size_t pos = 4, size = 0;
+
+    cache_init();
+    if (sc->file_opened) return;
+    sc->file_opened = 1;
+
+    sc->map = map_file(CACHE_FILE, &size);
+    sc->map_size = sc->map ? size : 0;
+    if (sc->map != NULL && size >= 4 && memcmp(sc->map, CACHE_MAGIC, 3) == 0 && sc->map[3] != CACHE_MAGIC[3]) {
+        unmap_file(sc->map, sc->map_size);     // written by another version: start over
+        sc->map = NULL;
+        sc->map_size = 0;
+    }
+    if (sc->map != NULL && (size < 4 || memcmp(sc->map, CACHE_MAGIC, 4) != 0)) {
+        set_color(RED);
+        printf("Warning: %s is not a solution cache; results will not be saved.\n", CACHE_FILE);
+        set_color(WHITE);
+        return;
+    }
+    while (sc->map != NULL && pos + sizeof(CacheRecord) <= size) {
+        CacheRecord rec;
+        memcpy(&rec, sc->map + pos, sizeof(rec));
+        if (rec.algo <= 0 || rec.moves < 0 || (size_t)rec.moves > size - pos - sizeof(rec)) break;
+        if (!cache_index(rec.hash, rec.algo, pos)) {
+            cache_drop_file();
+            return;
+        }
+        pos += sizeof(rec) + rec.moves;
+    }
+
+    if (sc->map != NULL) {
+        sc->out = fopen(CACHE_FILE, "r+b");     // a torn last record is overwritten
+        if (sc->out != NULL) fseek(sc->out, (long)pos, SEEK_SET);
+    }
+    else {
+        sc->out = fopen(CACHE_FILE, "wb");
+        if (sc->out != NULL && fwrite(CACHE_MAGIC, 1, 4, sc->out) != 4) {
+            fclose(sc->out);
+            sc->out = NULL;
+        }
+    }
+    sc->file_size = sc->written = pos;
+}
+
+/**
+ * @brief Checks that a cached record was made for the same maze and algorithm as key.
+ */
+int cache_matches(const CacheRecord* rec, const CacheRecord* key) {
+    return rec->hash == key->hash && rec->algo == key->algo && rec->rows == key->rows && rec->cols == key->cols
+        && rec->sr == key->sr && rec->sc == key->sc && rec->er == key->er && rec->ec == key->ec;
+}
+
+/**
+ * @brief Hash bucket of the in-memory tier for a maze hash.
+ */
+int cache_bucket(unsigned long long hash) {
+    return (int)(hash ^ hash >> 32) & (CACHE_LRU_BUCKETS - 1);
+}
+
+/**
+ * @brief Finds a key in the in-memory tier.
+ * @return Index of the entry, or -1 if it is not there
+ */
+int cache_recent(const CacheRecord* key) {
+    SolutionCache* sc = &solution_cache;
+    int i;
+    for (i = sc->lru_bucket[cache_bucket(key->hash)]; i != -1; i = sc->lru[i].chain) {
+        if (cache_matches(&sc->lru[i].rec, key)) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Moves an entry to the newest end of the recency list (adding it if it is not listed).
+ */
+void cache_touch(int i) {
+    SolutionCache* sc = &solution_cache;
+    CacheEntry* e = &sc->lru[i];
+
+    if (sc->lru_newest == i) return;
+    if (e->newer != -1) {           // listed: unlink it
+        sc->lru[e->newer].older = e->older;
+        if (e->older != -1) sc->lru[e->older].newer = e->newer;
+        else sc->lru_oldest = e->newer;
+    }
+    e->newer = -1;
+    e->older = sc->lru_newest;
+    if (sc->lru_newest != -1) sc->lru[sc->lru_newest].newer = i;
+    else sc->lru_oldest = i;
+    sc->lru_newest = i;
+}
+
+/**
+ * @brief Removes an entry from its hash bucket.
+ */
+void cache_unchain(int i) {
+    SolutionCache* sc = &solution_cache;
+    int* link = &sc->lru_bucket[cache_bucket(sc->lru[i].rec.hash)];
+    while (*link != i) link = &sc->lru[*link].chain;
+    *link = sc->lru[i].chain;
+}
+
+/**
+ * @brief Puts a result into the in-memory tier, evicting the least recently used entry.
+ */
+void cache_remember(const CacheRecord* rec, const char* moves) {
+    SolutionCache* sc = &solution_cache;
+    char* copy = (char*)malloc(rec->moves + 1);
+    int i;
+
+    if (copy == NULL) return;
+    memcpy(copy, moves, rec->moves);
+    copy[rec->moves] = '\0';
+
+    i = cache_recent(rec);
+    if (i == -1) {
+        if (sc->lru_count < CACHE_LRU_ENTRIES) i = sc->lru_count++;
+        else {
+            i = sc->lru_oldest;
+            cache_unchain(i);
+        }
+        int* head = &sc->lru_bucket[cache_bucket(rec->hash)];
+        sc->lru[i].chain = *head;
+        *head = i;
+    }
+    free(sc->lru[i].moves);
+    sc->lru[i].moves = copy;
+    sc->lru[i].rec = *rec;
+    cache_touch(i);
+}
+
+/**
+ * @brief Writes the pending records to CACHE_FILE; the cache lock must be held.
+ */
+void cache_write_pending(void) {
+    SolutionCache* sc = &solution_cache;
+
+    if (sc->pending_len == 0) return;
+    if (sc->out != NULL && fwrite(sc->pending, 1, sc->pending_len, sc->out) == sc->pending_len && fflush(sc->out) == 0) {
+        sc->written += sc->pending_len;
+    }
+    else if (sc->out != NULL) {
+        fclose(sc->out);            // stop writing rather than leave a gap in the file
+        sc->out = NULL;
+    }
+    sc->file_size = sc->written;
+    sc->pending_len = 0;
+    sc->pending_records = 0;
+}
+
+/**
+ * @brief Writes every pending record to CACHE_FILE.
+ */
+void cache_flush(void) {
+    SolutionCache* sc = &solution_cache;
+    if (!sc->opened) return;
+    mutex_lock(&sc->lock);
+    cache_write_pending();
+    mutex_unlock(&sc->lock);
+}
+
+/**
+ * @brief Looks up the result of an algorithm on a maze.
+ * @param rec Key: hash, algo, size, start and exit; on a hit also receives length and reached
+ * @param moves On a hit receives a malloc'ed copy of the move string
+ * @return 1 on a hit, 0 on a miss
+ */
+int cache_lookup(CacheRecord* rec, char** moves) {
+    SolutionCache* sc = &solution_cache;
+    CacheRecord found;
+    const char* text = NULL;
+    int i, hit = 0;
+
+    cache_init();
+    mutex_lock(&sc->lock);
+    i = cache_recent(rec);
+    if (i != -1) {
+        cache_touch(i);
+        found = sc->lru[i].rec;
+        text = sc->lru[i].moves;
+        hit = 1;
+    }
+    if (!hit && sc->slot_count > 0) {
+        CacheSlot* slot = cache_slot(rec->hash, rec->algo);
+        const char* at = NULL;
+        size_t avail = 0;
+        if (slot->algo != 0 && slot->offset >= sc->written) {
+            if (slot->offset - sc->written < sc->pending_len) {
+                at = sc->pending + (slot->offset - sc->written);
+                avail = sc->pending_len - (slot->offset - sc->written);
+            }
+        }
+        else if (slot->algo != 0) {
+            if (slot->offset + sizeof(CacheRecord) > sc->map_size) {
+                if (sc->map != NULL) unmap_file(sc->map, sc->map_size);
+                sc->map = map_file(CACHE_FILE, &sc->map_size);
+                if (sc->map == NULL) sc->map_size = 0;
+            }
+            if (slot->offset < sc->map_size) {
+                at = sc->map + slot->offset;
+                avail = sc->map_size - slot->offset;
+            }
+        }
+        if (at != NULL && avail >= sizeof(CacheRecord)) {
+            memcpy(&found, at, sizeof(found));
+            if (cache_matches(&found, rec) && found.moves >= 0 && sizeof(found) + found.moves <= avail) {
+                text = at + sizeof(found);
+                cache_remember(&found, text);
+                hit = 1;
+            }
+        }
+    }
+    if (hit) {
+        *moves = (char*)malloc(found.moves + 1);
+        if (*moves == NULL) hit = 0;
+        else {
+            memcpy(*moves, text, found.moves);
+            (*moves)[found.moves] = '\0';
+            rec->length = found.length;
+            rec->reached = found.reached;
+        }
+    }
+    mutex_unlock(&sc->lock);
+    return hit;
+}
+
+/**
+ * @brief Records the result of an algorithm in both tiers.
+ * @details The record joins the pending buffer; only every CACHE_FLUSH_RECORDS-th
+ *          call writes to the file. Call cache_flush when a run of stores is over.
+ * @param rec The result (rec->moves is set from moves)
+ * @param moves Move string of the path ("" if there is none)
+ */
+void cache_store(CacheRecord* rec, const char* moves) {
+    SolutionCache* sc = &solution_cache;
+    CacheSlot* slot;
+    size_t need;
+
+    cache_init();
+    rec->moves = (int)strlen(moves);
+    need = sizeof(*rec) + rec->moves;
+    mutex_lock(&sc->lock);
+    cache_remember(rec, moves);
+    slot = sc->slot_count > 0 ? cache_slot(rec->hash, rec->algo) : NULL;
+    if (sc->out != NULL && (slot == NULL || slot->algo == 0)) {
+        if (sc->pending_len + need > sc->pending_cap) {
+            size_t cap = sc->pending_cap ? sc->pending_cap : 16384;
+            while (cap < sc->pending_len + need) cap *= 2;
+            char* grown = (char*)realloc(sc->pending, cap);
+            if (grown != NULL) {
+                sc->pending = grown;
+                sc->pending_cap = cap;
+            }
+            else cache_write_pending();     // no room to buffer: write what is pending instead
+        }
+        if (sc->out != NULL && sc->pending_len + need <= sc->pending_cap) {
+            if (!cache_index(rec->hash, rec->algo, sc->file_size)) {
+                cache_write_pending();
+                cache_drop_file();
+                mutex_unlock(&sc->lock);
+                return;
+            }
+            memcpy(sc->pending + sc->pending_len, rec, sizeof(*rec));
+            memcpy(sc->pending + sc->pending_len + sizeof(*rec), moves, rec->moves);
+            sc->pending_len += need;
+            sc->file_size += need;
+            if (++sc->pending_records >= CACHE_FLUSH_RECORDS) cache_write_pending();
+        }
+    }
+    mutex_unlock(&sc->lock);
+}
+
+/**
+ * @brief Fills the key of a cache record for the loaded maze.
+ */
+void maze_cache_key(CacheRecord* rec, int algo) {
+    memset(rec, 0, sizeof(*rec));
+    rec->hash = current_maze_hash();
+    rec->algo = algo;
+    rec->rows = rows;
+    rec->cols = cols;
+    rec->sr = sr;
+    rec->sc = sc;
+    rec->er = er;
+    rec->ec = ec;
+}
+
+/** @} */
+
+/**
+ * @defgroup MazeIO Maze File Loading & Validation
+ * @{
+ */
+
+ /**
+  * @brief Tells whether a character is a key cell.
+  * @details Lowercase letters are keys, except those whose uppercase form is reserved
+  *          ('S', 'E', 'K') and therefore cannot be a door.
+  */
+int is_key(char ch) {
+    return ch >= 'a' && ch <= 'z' && ch != 's' && ch != 'e' && ch != 'k';
+}
+
+/**
+ * @brief Tells whether a character is a door cell (uppercase, not 'S', 'E' or 'K').
+ */
+int is_door(char ch) {
+    return ch >= 'A' && ch <= 'Z' && ch != 'S' && ch != 'E' && ch != 'K';
+}
+
+/**
+ * @brief Applies a directive line of the maze file (a line starting with ';').
+ * @details Known directives: ";wrap" and ";gate <char> <p> <q>".
+ * @param text Directive text after the ';'
+ * @return 1 if the directive is known, 0 otherwise (error printed)
+ */
+int parse_directive(const char* text) {
+    char ch;
+    int p, q;
+    if (strcmp(text, "wrap") == 0) {
+        wrap_mode = 1;
+        return 1;
+    }
+    if (sscanf(text, "gate %c %d %d", &ch, &p, &q) == 3) {
+        if (ch == '#' || ch == 'S' || ch == 'E' || p < 1 || p > MAX_TIME_PERIOD || q < 0 || q > p) {
+            set_color(RED);
+            printf("Error: Invalid gate directive ';%s'!\n", text);
+            set_color(WHITE);
+            return 0;
+        }
+        gate_period[(unsigned char)ch] = p;
+        gate_open[(unsigned char)ch] = q;
+        return 1;
+    }
+    set_color(RED);
+    printf("Error: Unknown directive ';%s'!\n", text);
+    set_color(WHITE);
+    return 0;
+}
+
+/**
+ * @brief Pairs up the portal cells and fills portal_to.
+ * @details Every character of PORTAL_CHARS that occurs must occur exactly twice.
+ * @return 1 on success, 0 if a portal has no partner or more than one (error printed)
+ */
+int scan_portals(void) {
+    const char* p;
+    int i, j;
+
+    num_portals = 0;
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            portal_to[i][j] = -1;
+        }
+    }
+
+    for (p = PORTAL_CHARS; *p; p++) {
+        int found = 0, first = -1;
+        for (i = 0; i < rows; i++) {
+            for (j = 0; j < cols; j++) {
+                if (maze[i][j] != *p) continue;
+                found++;
+                if (found == 1) {
+                    first = i * MAXC + j;
+                }
+                else if (found == 2) {
+                    portal_to[first / MAXC][first % MAXC] = i * MAXC + j;
+                    portal_to[i][j] = first;
+                    portal_a[num_portals] = first;
+                    portal_b[num_portals] = i * MAXC + j;
+                    num_portals++;
+                }
+            }
+        }
+        if (found != 0 && found != 2) {
+            set_color(RED);
+            printf("Portal '%c' must appear exactly twice!\n", *p);
+            set_color(WHITE);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Assigns key-mask bits to the key letters in order of first appearance.
+ * @details Only the first MAX_KEY_TYPES letters get a bit; num_key_types still
+ *          counts all of them so callers can reject mazes with too many.
+ */
+void scan_keys(void) {
+    int i, j;
+    for (i = 0; i < 26; i++) key_bit[i] = -1;
+    num_key_types = 0;
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            char ch = maze[i][j];
+            if (!is_key(ch) || key_bit[ch - 'a'] != -1) continue;
+            key_bit[ch - 'a'] = num_key_types < MAX_KEY_TYPES ? num_key_types : MAX_KEY_TYPES;
+            num_key_types++;
+        }
+    }
+}
+
+ /**
+  * @brief Loads and validates the maze from the input text file.
+  * @details Reads line by line up to the first blank line after the rows (later
+  *          floors are only used by the 3D mode), removes trailing newline, ensures uniform row length,
+  *          records every 'S' and 'E' (sr/sc and er/ec keep the last of each),
+  *          and labels the connected regions.
+  * @return 1 on success, 0 on failure (error message is printed)
+  */
+int load_maze(void) {
+    FILE* f = fopen(filename, "r");
+    if (f == NULL) {
+        set_color(RED);
+        printf("Error: maze.txt not found or cannot be opened!\n");
+        set_color(WHITE);
+        return 0;
+    }
+
+    rows = 0;
+    wrap_mode = 0;
+    conn_ready = 0;
+    memset(gate_period, 0, sizeof(gate_period));
+    char line[MAXC];
+    while (fgets(line, MAXC, f) != NULL) {
+        size_t len = strlen(line);
+        if (len > 0 && line[len - 1] == '\n') {
+            line[len - 1] = '\0';
+            len--;
+        }
+        if (len == 0) {
+            if (rows > 0) break;    // a blank line ends the first floor
+            continue;
+        }
+        if (line[0] == ';') {
+            if (!parse_directive(line + 1)) {
+                fclose(f);
+                return 0;
+            }
+            continue;
+        }
+
+        strcpy(maze[rows], line);
+
+        if (rows == 0) {
+            cols = (int)len;
+        }
+        else if ((int)len != cols) {
+            set_color(RED);
+            printf("Error: All rows must have the same length!\n");
+            set_color(WHITE);
+            fclose(f);
+            return 0;
+        }
+
+        rows++;
+        if (rows >= MAXR) break;
+    }
+    fclose(f);
+
+    if (rows == 0 || cols == 0) {
+        set_color(RED);
+        printf("Maze is empty!\n");
+        set_color(WHITE);
+        return 0;
+    }
+
+    sr = sc = er = ec = -1;
+    num_starts = num_exits = 0;
+    int i, j;
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            if (maze[i][j] == 'S') {
+                sr = i; sc = j;
+                starts_r[num_starts] = i;
+                starts_c[num_starts] = j;
+                num_starts++;
+            }
+            if (maze[i][j] == 'E') {
+                er = i; ec = j;
+                exits_r[num_exits] = i;
+                exits_c[num_exits] = j;
+                num_exits++;
+            }
+        }
+    }
+
+    if (sr == -1 || er == -1) {
+        set_color(RED);
+        printf("Maze must contain 'S' and 'E'!\n");
+        set_color(WHITE);
+        return 0;
+    }
+
+    build_successor_tables();
+    if (!scan_portals()) return 0;
+    scan_keys();
+    label_components();
+    use_row_bfs = cols <= ROW_BITS;
+    maze_hash = grid_hash((const char(*)[MAXC])maze, rows, cols, sr, sc, er, ec, wrap_mode);
+    maze_hash_stale = 0;
+    return 1;
+}
+
+/** @} */
+
+/**
+ * @defgroup Display Maze Rendering
+ * @{
+ */
+
+ /**
+  * @brief Clears the terminal screen and renders the maze grid with colored characters.
+  * @param grid The maze grid to display (can be original or modified copy)
+  * @param show_player If non-zero, renders the player position as red '^'
+  */
+void print_maze(const char grid[MAXR][MAXC], int show_player) {
+#ifdef _WIN32
+    system("cls");
+#else
+    system("clear");
+#endif  // Windows only; consider "clear" for Unix-like systems
+
+    int i, j;
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            char ch = grid[i][j];
+
+            if (show_player && i == pr && j == pc) {
+                set_color(RED);
+                printf("^");
+                set_color(WHITE);
+            }
+            else if (ch == 'S' || ch == 'E' || ch == 'K') {
+                set_color(BLUE);   // Bright blue
+                printf("%c", ch);
+                set_color(WHITE);
+            }
+            else if (ch == '^') {
+                set_color(RED); // Path markers
+                printf("^");
+                set_color(WHITE);
+            }
+            else if (ch == '#') {
+                set_color(YELLOW); // Walls
+                printf("%c", ch);
+                set_color(WHITE);
+            }
+            else if (ch == 'b') {
+                set_color(GREEN); // Shortest path cells
+                printf("%c", ch);
+                set_color(WHITE);
+            }
+            else if (ch == '+') {
+                set_color(CYAN); // Cells on some shortest path
+                printf("%c", ch);
+                set_color(WHITE);
+            }
+            else if (ch == '!') {
+                set_color(MAGENTA); // Chokepoints
+                printf("%c", ch);
+                set_color(WHITE);
+            }
+            else if (ch == '%') {
+                set_color(RED); // Walls suggested for removal
+                printf("%c", ch);
+                set_color(WHITE);
+            }
+            else {
+                printf("%c", ch);
+            }
+        }
+        printf("\n");
+    }
+    printf("\n");
+}
+
+/**
+ * @brief Discards the rest of the current input line.
+ */
+void skip_line(void) {
+    int ch;
+    while ((ch = getchar()) != '\n' && ch != EOF);
+}
+
+/**
+ * @brief Reads one line of input without its line ending.
+ * @param buf Destination buffer
+ * @param size Size of buf in bytes
+ */
+void read_line(char* buf, int size) {
+    size_t len;
+    if (fgets(buf, size, stdin) == NULL) {
+        buf[0] = '\0';
+        return;
+    }
+    len = strlen(buf);
+    while (len > 0 && (buf[len - 1] == '\n' || buf[len - 1] == '\r')) buf[--len] = '\0';
+}
+
+/**
+ * @brief Waits until the user presses Enter, so a report stays on screen.
+ */
+void wait_for_enter(void) {
+    printf("Press Enter to continue...");
+    skip_line();
+}
+
+/** @} */
+
+/**
+ * @defgroup Movement Player Movement Logic
+ * @{
+ */
+
+ /**
+  * @brief Validates whether a cell is inside the maze and passable.
+  * @param r Row index
+  * @param c Column index
+  * @return 1 if the position is valid and not a wall, 0 otherwise
+  */
+int is_valid(int r, int c) {
+    if (r < 0 || r >= rows || c < 0 || c >= cols) return 0;
+    if (maze[r][c] == '#') return 0;
+    return 1;
+}
+
+/**
+ * @brief Tells whether a door cell can be passed while holding the given keys.
+ * @details Doors without a matching key anywhere in the maze never open.
+ * @param ch Door character
+ * @param keys Mask of keys held
+ */
+int door_open(char ch, int keys) {
+    int bit = key_bit[ch - 'A'];
+    return bit >= 0 && bit < MAX_KEY_TYPES && (keys & (1 << bit));
+}
+
+/**
+ * @brief Handles player movement based on keyboard input.
+ * @param ch Input character representing direction ('w','a','s','d') or other
+ */
+void move_player(char ch) {
+    int nr = -1, nc = -1;
+
+    if (ch == 'w' || ch == 'W') neighbor_cell(pr, pc, 0, &nr, &nc);
+    else if (ch == 's' || ch == 'S') neighbor_cell(pr, pc, 1, &nr, &nc);
+    else if (ch == 'a' || ch == 'A') neighbor_cell(pr, pc, 2, &nr, &nc);
+    else if (ch == 'd' || ch == 'D') neighbor_cell(pr, pc, 3, &nr, &nc);
+    else {
+        set_color(RED);
+        printf("Invalid movement! Use w, a, s, d or q to quit.\n");
+        set_color(WHITE);
+#ifdef _WIN32
+        Sleep(1000);
+#else
+        sleep(1);
+#endif
+        return;
+    }
+
+    if (is_valid(nr, nc) && is_door(maze[nr][nc]) && !door_open(maze[nr][nc], held_keys)) {
+        set_color(RED);
+        printf("The door is locked! Find key '%c' first.\n", maze[nr][nc] - 'A' + 'a');
+        set_color(WHITE);
+#ifdef _WIN32
+        Sleep(1000);
+#else
+        sleep(1);
+#endif
+    }
+    else if (is_valid(nr, nc)) {
+        pr = nr;        // neighbor_cell already took the portal if one was stepped onto
+        pc = nc;
+        if (is_key(maze[pr][pc]) && key_bit[maze[pr][pc] - 'a'] < MAX_KEY_TYPES) {
+            held_keys |= 1 << key_bit[maze[pr][pc] - 'a'];
+        }
+    }
+    else {
+        set_color(RED);
+        printf("Invalid movement! Cannot go through walls or out of bounds.\n");
+        set_color(WHITE);
+#ifdef _WIN32
+        Sleep(1000);
+#else
+        sleep(1);
+#endif
+    }
+}
+
+/** @} */
+
+/**
+ * @defgroup Manual Manual Gameplay Mode
+ * @{
+ */
+
+ /**
+  * @brief Toggles the wall beside the player: i up, k down, j left, l right.
+  * @param ch Key pressed by the player
+  */
+void edit_beside_player(char ch) {
+    const char* keys = "ikjlIKJL";
+    int d = (int)(strchr(keys, ch) - keys) % 4;
+    int nr, nc;
+
+    if (!step_cell(pr, pc, d, &nr, &nc) || (nr == pr && nc == pc) || !flip_wall(nr, nc)) {
+        set_color(RED);
+        printf("Only walls and plain open cells can be toggled!\n");
+        set_color(WHITE);
+#ifdef _WIN32
+        Sleep(1000);
+#else
+        sleep(1);
+#endif
+    }
+}
+
+/**
+ * @brief Interactive loop for manual maze navigation using WASD keys.
+ */
+void play_manual(void) {
+    pr = sr;
+    pc = sc;
+    held_keys = 0;
+
+    while (1) {
+        print_maze(maze, 1);
+
+        if (maze[pr][pc] == 'E') {
+            set_color(GREEN);
+            printf("Congratulations! You reached the exit!\n\n");
+            set_color(WHITE);
+            break;
+        }
+
+        if (conn_connected(pr, pc, er, ec)) {
+            set_color(GREEN);
+            printf("The exit can be reached from here.\n");
+        }
+        else {
+            set_color(RED);
+            printf("The exit can no longer be reached from here!\n");
+        }
+        set_color(WHITE);
+
+        printf("Move (w a s d), toggle the wall beside you (i j k l) or q to quit: ");
+        char ch;
+        scanf(" %c", &ch);
+
+        if (ch == 'q' || ch == 'Q') {
+            set_color(RED);
+            printf("You quit the game.\n");
+            set_color(WHITE);
+            return;
+        }
+
+        if (strchr("ikjlIKJL", ch) != NULL) edit_beside_player(ch);
+        else move_player(ch);
+    }
+}
+
+/** @} */
+
+/**
+ * @defgroup BFS Shortest Path Computation (BFS)
+ * @{
+ */
+
+ /**
+  * @brief Marks the path ending at a given cell by following parent links back to a source.
+  * @param tr Row of the last cell of the path
+  * @param tc Column of the last cell of the path
+  * @param parent_r 2D array of parent row indices (-1 at the source)
+  * @param parent_c 2D array of parent column indices (-1 at the source)
+  */
+void mark_path_to(int tr, int tc, int parent_r[MAXR][MAXC], int parent_c[MAXR][MAXC]) {
+    int cr = tr, cc = tc;
+    int length = 0;
+
+    while (parent_r[cr][cc] != -1) {
+        int tempr = parent_r[cr][cc];
+        int tempc = parent_c[cr][cc];
+        if (maze[cr][cc] != 'S' && maze[cr][cc] != 'E') {
+            maze[cr][cc] = 'b';
+        }
+        cr = tempr;
+        cc = tempc;
+        length++;
+    }
+
+    set_color(YELLOW);
+    printf("Shortest path (length: %d steps):\n", length);
+    set_color(WHITE);
+#ifdef _WIN32
+    Sleep(1300);
+#else
+    sleep(1);
+#endif
+}
+
+/**
+ * @brief Reconstructs and marks the shortest path on the maze using parent information.
+ * @param parent_r 2D array of parent row indices from BFS
+ * @param parent_c 2D array of parent column indices from BFS
+ */
+void mark_shortest_path(int parent_r[MAXR][MAXC], int parent_c[MAXR][MAXC]) {
+    mark_path_to(er, ec, parent_r, parent_c);
+}
+
+/**
+ * @brief Shortest path by a BFS over bit rows, for mazes of at most ROW_BITS columns.
+ * @details Each row is one 64-bit word, so a BFS level is a few shifts and masks per
+ *          row on arrays small enough to stay in registers and L1. Wrap-around rotates
+ *          the row words, and each portal pair swaps the bits of its two ends once per
+ *          level before the visited mask is applied. The frontier of
+ *          every level is kept, and the path is traced back from 'E' through them.
+ * @param parent_r Receives the parent row of each cell of the path (-1 at 'S')
+ * @param parent_c Receives the parent column of each cell of the path
+ * @return 1 if 'E' was reached, 0 if not, -1 if out of memory
+ */
+int row_bfs(int parent_r[MAXR][MAXC], int parent_c[MAXR][MAXC]) {
+    unsigned long long open[MAXR], seen[MAXR], buffers[2][MAXR + 2];   // row r is at r + 1; rows 0 and rows + 1 stay empty
+    unsigned long long *frontier = buffers[0], *next = buffers[1], *swap;
+    unsigned long long* levels = NULL;
+    int count = 0, cap = 0, found = 0, last = cols - 1, r, c, i;
+
+    memset(buffers, 0, sizeof(buffers));
+    for (r = 0; r < rows; r++) {
+        open[r] = 0;
+        for (c = 0; c < cols; c++) {
+            if (is_valid(r, c)) open[r] |= 1ULL << c;
+        }
+        seen[r] = 0;
+    }
+    frontier[sr + 1] = seen[sr] = 1ULL << sc;
+
+    while (!found) {
+        unsigned long long any = 0;
+        if (count == cap) {
+            unsigned long long* grown;
+            cap = cap ? cap * 2 : 256;
+            grown = (unsigned long long*)realloc(levels, sizeof(unsigned long long) * cap * rows);
+            if (grown == NULL) {
+                free(levels);
+                return -1;
+            }
+            levels = grown;
+        }
+        memcpy(levels + count * rows, frontier + 1, sizeof(unsigned long long) * rows);
+        count++;
+
+        for (r = 0; r < rows; r++) {
+            unsigned long long f = frontier[r + 1];
+            unsigned long long step = frontier[r] | frontier[r + 2];
+            if (wrap_mode) {
+                step |= (f << 1 | f >> last) | (f >> 1 | f << last);    // rotations within the row width
+                if (r == 0) step |= frontier[rows];
+                if (r == rows - 1) step |= frontier[1];
+            }
+            else step |= f << 1 | f >> 1;
+            next[r + 1] = step & open[r];
+        }
+        for (i = 0; i < num_portals; i++) {     // a step onto one end lands on the other
+            int ar = portal_a[i] / MAXC, ac = portal_a[i] % MAXC;
+            int br = portal_b[i] / MAXC, bc = portal_b[i] % MAXC;
+            unsigned long long onto_a = next[ar + 1] >> ac & 1, onto_b = next[br + 1] >> bc & 1;
+            next[ar + 1] = (next[ar + 1] & ~(1ULL << ac)) | onto_b << ac;
+            next[br + 1] = (next[br + 1] & ~(1ULL << bc)) | onto_a << bc;
+        }
+        for (r = 0; r < rows; r++) {
+            next[r + 1] &= ~seen[r];
+            seen[r] |= next[r + 1];
+            any |= next[r + 1];
+        }
+
+        swap = frontier;
+        frontier = next;
+        next = swap;
+        if (any == 0) break;
+        found = frontier[er + 1] >> ec & 1;
+    }
+
+    if (found) {
+        int cr = er, cc = ec, k, d, nr = 0, nc = 0;
+        for (k = count; k > 0; k--) {
+            const unsigned long long* prev = levels + (k - 1) * rows;
+            for (d = 0; d < NUM_MOVES; d++) {
+                if (prev_cell(cr, cc, d, &nr, &nc) && (prev[nr] >> nc & 1)) break;
+            }
+            parent_r[cr][cc] = nr;
+            parent_c[cr][cc] = nc;
+            cr = nr;
+            cc = nc;
+        }
+        parent_r[sr][sc] = -1;
+        parent_c[sr][sc] = -1;
+    }
+    free(levels);
+    return found;
+}
+
+/**
+ * @brief Spells out the path ending at 'E' as moves from 'S' (see move_letters).
+ * @return Malloc'ed move string, or NULL if out of memory
+ */
+char* parents_to_moves(int parent_r[MAXR][MAXC], int parent_c[MAXR][MAXC]) {
+    int cr = er, cc = ec, len = 0, d, nr, nc;
+    char* moves;
+
+    while (parent_r[cr][cc] != -1) {
+        int tr = parent_r[cr][cc];
+        cc = parent_c[cr][cc];
+        cr = tr;
+        len++;
+    }
+    moves = (char*)malloc(len + 1);
+    if (moves == NULL) return NULL;
+    moves[len] = '\0';
+    for (cr = er, cc = ec; parent_r[cr][cc] != -1; cr = nr, cc = nc) {
+        nr = parent_r[cr][cc];
+        nc = parent_c[cr][cc];
+        for (d = 0; d < NUM_MOVES; d++) {
+            int tr, tc;
+            if (neighbor_cell(nr, nc, d, &tr, &tc) && tr == cr && tc == cc) break;
+        }
+        moves[--len] = move_letters[d];
+    }
+    return moves;
+}
+
+/**
+ * @brief Replays a move string from 'S', filling parent links along the way.
+ * @return 1 if the moves stay on open cells and end at 'E', 0 otherwise
+ */
+int moves_to_parents(const char* moves, int parent_r[MAXR][MAXC], int parent_c[MAXR][MAXC]) {
+    int cr = sr, cc = sc;
+
+    parent_r[sr][sc] = -1;
+    parent_c[sr][sc] = -1;
+    for (; *moves; moves++) {
+        const char* d = strchr(move_letters, *moves);
+        int nr, nc;
+        if (d == NULL || !neighbor_cell(cr, cc, (int)(d - move_letters), &nr, &nc) || !is_valid(nr, nc)) return 0;
+        parent_r[nr][nc] = cr;
+        parent_c[nr][nc] = cc;
+        cr = nr;
+        cc = nc;
+    }
+    return cr == er && cc == ec;
+}
+
+/**
+ * @brief Computes the shortest path from 'S' to 'E' using Breadth-First Search.
+ * @details Takes the path from the solution cache when this maze was solved before.
+ *          Otherwise uses row_bfs when load_maze found the maze narrow enough, or a
+ *          queue and parent tracking to reconstruct the path, and caches the result.
+ */
+void bfs_shortest(void) {
+    int visited[MAXR][MAXC] = { 0 };
+    int parent_r[MAXR][MAXC];
+    int parent_c[MAXR][MAXC];
+    int found, cached = 0;
+    CacheRecord rec;
+    char* moves = NULL;
+
+    if (!same_component(sr, sc, er, ec)) {
+        set_color(RED);
+        printf("No path exists!\n");
+        set_color(WHITE);
+        return;
+    }
+
+    maze_cache_key(&rec, CACHE_BFS);
+    if (cache_lookup(&rec, &moves)) {
+        cached = rec.length >= 0 && moves_to_parents(moves, parent_r, parent_c);
+        free(moves);
+        moves = NULL;
+    }
+
+    found = cached ? 1 : use_row_bfs ? row_bfs(parent_r, parent_c) : -1;
+    if (found == -1) {
+        found = 0;
+        queue_init();
+        queue_push(sr, sc);
+        visited[sr][sc] = 1;
+        parent_r[sr][sc] = -1;
+        parent_c[sr][sc] = -1;
+
+        while (!queue_empty() && !found) {
+            int cr, cc;
+            queue_pop(&cr, &cc);
+
+            int d;
+            for (d = 0; d < NUM_MOVES; d++) {
+                int nr, nc;
+                if (!neighbor_cell(cr, cc, d, &nr, &nc)) continue;
+
+                if (!is_valid(nr, nc)) continue;
+                if (visited[nr][nc]) continue;
+
+                visited[nr][nc] = 1;
+                parent_r[nr][nc] = cr;
+                parent_c[nr][nc] = cc;
+                queue_push(nr, nc);
+
+                if (nr == er && nc == ec) {
+                    found = 1;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (!found) {
+        set_color(RED);
+        printf("No path exists!\n");
+        set_color(WHITE);
+        return;
+    }
+
+    if (!cached && (moves = parents_to_moves(parent_r, parent_c)) != NULL) {
+        rec.length = (int)strlen(moves);
+        rec.reached = -1;
+        cache_store(&rec, moves);
+        free(moves);
+    }
+    mark_shortest_path(parent_r, parent_c);
+    print_maze(maze, 0);
+    if (cached) printf("(Path taken from the solution cache.)\n");
+}
+
+/**
+ * @brief Work item for running bfs_distances on a worker thread.
+ */
+typedef struct {
+    int src_r, src_c;           /**< Source cell */
+    int backward;               /**< 1 to follow moves backwards, giving distances to the source */
+    int (*dist)[MAXC];          /**< Receives distances from the source (-1 if unreachable) */
+    int* order;                 /**< Receives reached cells in BFS order (QSIZE entries) */
+    int count;                  /**< Number of cells reached */
+} BfsJob;
+
+/**
+ * @brief Computes the BFS distance from one cell to every reachable cell.
+ * @details Reentrant: uses the caller's order buffer as its queue instead of the
+ *          global BFS queue, so several searches can run on different threads.
+ * @param src_r Source row
+ * @param src_c Source column
+ * @param backward 1 to follow moves backwards (prev_cell), so dist holds distances to the source
+ * @param dist Receives distances (-1 for unreachable cells and walls)
+ * @param order Receives cell indices (r * MAXC + c) in the order they were reached
+ * @return Number of cells reached, including the source
+ */
+int bfs_distances(int src_r, int src_c, int backward, int dist[MAXR][MAXC], int* order) {
+    int (*move)(int, int, int, int*, int*) = backward ? prev_cell : neighbor_cell;
+    int head = 0, tail = 0;
+    int i, j;
+
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            dist[i][j] = -1;
+        }
+    }
+
+    dist[src_r][src_c] = 0;
+    order[tail++] = src_r * MAXC + src_c;
+
+    while (head < tail) {
+        int cr = order[head] / MAXC, cc = order[head] % MAXC;
+        head++;
+
+        int d;
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!move(cr, cc, d, &nr, &nc)) continue;
+            if (!is_valid(nr, nc)) continue;
+            if (dist[nr][nc] != -1) continue;
+
+            dist[nr][nc] = dist[cr][cc] + 1;
+            order[tail++] = nr * MAXC + nc;
+        }
+    }
+    return tail;
+}
+
+/**
+ * @brief Thread body running bfs_distances for a BfsJob.
+ */
+THREAD_FUNC(bfs_job_worker) {
+    BfsJob* job = (BfsJob*)arg;
+    job->count = bfs_distances(job->src_r, job->src_c, job->backward, job->dist, job->order);
+    THREAD_RETURN;
+}
+
+/** @} */
+
+/**
+ * @defgroup Weighted Weighted Terrain (Dial's Algorithm / 0-1 BFS)
+ * @{
+ */
+
+ /**
+  * @brief Returns the cost of stepping onto a cell.
+  * @details Terrain digits '0'-'9' cost their value; every other open cell costs 1.
+  * @param r Row index
+  * @param c Column index
+  * @return Step cost between 0 and MAX_TERRAIN_COST
+  */
+int cell_cost(int r, int c) {
+    char ch = maze[r][c];
+    if (ch >= '0' && ch <= '9') return ch - '0';
+    return 1;
+}
+
+/**
+ * @brief Cheapest-path search with a circular array of buckets (Dial's algorithm).
+ * @details Since every step costs at most MAX_TERRAIN_COST, all pending distances
+ *          fit in MAX_TERRAIN_COST + 1 buckets indexed by distance modulo that count.
+ *          Stale entries are skipped when popped instead of being removed.
+ * @param dist Receives the cheapest cost from S to every settled cell
+ * @param parent_r Receives the parent row of each reached cell
+ * @param parent_c Receives the parent column of each reached cell
+ */
+void dial_search(int dist[MAXR][MAXC], int parent_r[MAXR][MAXC], int parent_c[MAXR][MAXC]) {
+    int used = 0, pending = 0, cur = 0;
+    int i;
+
+    for (i = 0; i <= MAX_TERRAIN_COST; i++) dial_head[i] = -1;
+
+    dist[sr][sc] = 0;
+    dial_cell[used] = sr * MAXC + sc;
+    dial_next[used] = -1;
+    dial_head[0] = used++;
+    pending = 1;
+
+    while (pending > 0) {
+        int b = cur % (MAX_TERRAIN_COST + 1);
+        if (dial_head[b] == -1) {
+            cur++;
+            continue;
+        }
+
+        int e = dial_head[b];
+        dial_head[b] = dial_next[e];
+        pending--;
+
+        int cr = dial_cell[e] / MAXC, cc = dial_cell[e] % MAXC;
+        if (dist[cr][cc] != cur) continue;   // stale entry
+        if (cr == er && cc == ec) return;
+
+        int d;
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!neighbor_cell(cr, cc, d, &nr, &nc)) continue;
+            if (!is_valid(nr, nc)) continue;
+
+            int nd = cur + cell_cost(nr, nc);
+            if (nd >= dist[nr][nc]) continue;
+
+            dist[nr][nc] = nd;
+            parent_r[nr][nc] = cr;
+            parent_c[nr][nc] = cc;
+
+            int nb = nd % (MAX_TERRAIN_COST + 1);
+            dial_cell[used] = nr * MAXC + nc;
+            dial_next[used] = dial_head[nb];
+            dial_head[nb] = used++;
+            pending++;
+        }
+    }
+}
+
+/**
+ * @brief Cheapest-path search for mazes whose step costs are all 0 or 1 (0-1 BFS).
+ * @details Free steps are pushed to the front of a deque and unit steps to the back,
+ *          so cells leave the deque in order of distance.
+ * @param dist Receives the cheapest cost from S to every settled cell
+ * @param parent_r Receives the parent row of each reached cell
+ * @param parent_c Receives the parent column of each reached cell
+ */
+void zero_one_bfs(int dist[MAXR][MAXC], int parent_r[MAXR][MAXC], int parent_c[MAXR][MAXC]) {
+    int head = 0, tail = 0;
+
+    dist[sr][sc] = 0;
+    deque_cell[tail] = sr * MAXC + sc;
+    tail = (tail + 1) % DIAL_POOL;
+
+    while (head != tail) {
+        int x = deque_cell[head];
+        head = (head + 1) % DIAL_POOL;
+
+        int cr = x / MAXC, cc = x % MAXC;
+        if (cr == er && cc == ec) return;
+
+        int d;
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!neighbor_cell(cr, cc, d, &nr, &nc)) continue;
+            if (!is_valid(nr, nc)) continue;
+
+            int w = cell_cost(nr, nc);
+            int nd = dist[cr][cc] + w;
+            if (nd >= dist[nr][nc]) continue;
+
+            dist[nr][nc] = nd;
+            parent_r[nr][nc] = cr;
+            parent_c[nr][nc] = cc;
+
+            if (w == 0) {
+                head = (head + DIAL_POOL - 1) % DIAL_POOL;
+                deque_cell[head] = nr * MAXC + nc;
+            }
+            else {
+                deque_cell[tail] = nr * MAXC + nc;
+                tail = (tail + 1) % DIAL_POOL;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Computes and marks the cheapest path from 'S' to 'E' over weighted terrain.
+ * @details Picks 0-1 BFS when every step costs 0 or 1 and Dial's bucket queue otherwise.
+ *          The path is rendered exactly like the BFS shortest path.
+ */
+void weighted_shortest(void) {
+    int dist[MAXR][MAXC];
+    int parent_r[MAXR][MAXC];
+    int parent_c[MAXR][MAXC];
+    int max_cost = 0;
+    int i, j;
+
+    if (!same_component(sr, sc, er, ec)) {
+        set_color(RED);
+        printf("No path exists!\n");
+        set_color(WHITE);
+        return;
+    }
+
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            dist[i][j] = INT_MAX;
+            if (maze[i][j] != '#' && cell_cost(i, j) > max_cost) max_cost = cell_cost(i, j);
+        }
+    }
+    parent_r[sr][sc] = -1;
+    parent_c[sr][sc] = -1;
+
+    if (max_cost <= 1) zero_one_bfs(dist, parent_r, parent_c);
+    else dial_search(dist, parent_r, parent_c);
+
+    set_color(YELLOW);
+    printf("Cheapest path (%s, total cost: %d):\n",
+        max_cost <= 1 ? "0-1 BFS" : "Dial's algorithm", dist[er][ec]);
+    set_color(WHITE);
+
+    mark_shortest_path(parent_r, parent_c);
+    print_maze(maze, 0);
+}
+
+/** @} */
+
+/**
+ * @defgroup MultiBFS Multi-Source BFS & Evacuation Map
+ * @{
+ */
+
+ /**
+  * @brief Breadth-first search seeded from several cells at once.
+  * @details All sources start at distance 0 in the shared BFS queue. Every reached
+  *          cell records its distance and the index of the source it was reached from,
+  *          which for a multi-source BFS is a nearest source.
+  * @param n Number of sources
+  * @param src_r Row coordinates of the sources
+  * @param src_c Column coordinates of the sources
+  * @param backward 1 to follow moves backwards (prev_cell), so dist is the distance to the nearest source
+  * @param dist Receives the distance to the nearest source (-1 if unreachable)
+  * @param owner Receives the index of the nearest source (-1 if unreachable)
+  * @param parent_r Receives parent rows (-1 at sources)
+  * @param parent_c Receives parent columns (-1 at sources)
+  * @param stop_char Stop as soon as a cell holding this character is reached (0 floods everything)
+  * @return Cell index (r * MAXC + c) of the stop cell reached, or -1
+  */
+int multi_source_bfs(int n, const int* src_r, const int* src_c, int backward, int dist[MAXR][MAXC],
+    int owner[MAXR][MAXC], int parent_r[MAXR][MAXC], int parent_c[MAXR][MAXC], char stop_char) {
+    int (*move)(int, int, int, int*, int*) = backward ? prev_cell : neighbor_cell;
+    int i, j;
+
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            dist[i][j] = -1;
+            owner[i][j] = -1;
+        }
+    }
+
+    queue_init();
+    for (i = 0; i < n; i++) {
+        int r = src_r[i], c = src_c[i];
+        if (dist[r][c] != -1) continue;
+        dist[r][c] = 0;
+        owner[r][c] = i;
+        parent_r[r][c] = -1;
+        parent_c[r][c] = -1;
+        if (stop_char && maze[r][c] == stop_char) return r * MAXC + c;
+        queue_push(r, c);
+    }
+
+    while (!queue_empty()) {
+        int cr, cc;
+        queue_pop(&cr, &cc);
+
+        int d;
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!move(cr, cc, d, &nr, &nc)) continue;
+
+            if (!is_valid(nr, nc)) continue;
+            if (dist[nr][nc] != -1) continue;
+
+            dist[nr][nc] = dist[cr][cc] + 1;
+            owner[nr][nc] = owner[cr][cc];
+            parent_r[nr][nc] = cr;
+            parent_c[nr][nc] = cc;
+            if (stop_char && maze[nr][nc] == stop_char) return nr * MAXC + nc;
+            queue_push(nr, nc);
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Returns the character used to draw exit number k on the evacuation map.
+ */
+char exit_symbol(int k) {
+    if (k < 9) return (char)('1' + k);
+    if (k < 9 + 26) return (char)('A' + k - 9);
+    return '+';
+}
+
+/**
+ * @brief Shows the shortest route from any start to any exit and the nearest-exit map.
+ * @details One BFS seeded from every 'S' stops at the first 'E' it reaches; a second
+ *          BFS seeded from every 'E', run backwards, assigns each open cell to its closest exit.
+ */
+void evacuation_analysis(void) {
+    int dist[MAXR][MAXC];
+    int owner[MAXR][MAXC];
+    int parent_r[MAXR][MAXC];
+    int parent_c[MAXR][MAXC];
+    char view[MAXR][MAXC];
+    int served[QSIZE];
+    int farthest[QSIZE];
+    int unreachable = 0;
+    int i, j, k;
+
+    int hit = multi_source_bfs(num_starts, starts_r, starts_c, 0, dist, owner, parent_r, parent_c, 'E');
+    if (hit == -1) {
+        set_color(RED);
+        printf("No start can reach an exit!\n");
+        set_color(WHITE);
+    }
+    else {
+        int hr = hit / MAXC, hc = hit % MAXC;
+        set_color(YELLOW);
+        printf("%d start(s), %d exit(s). Nearest exit from start (%d, %d) is (%d, %d).\n",
+            num_starts, num_exits, starts_r[owner[hr][hc]], starts_c[owner[hr][hc]], hr, hc);
+        set_color(WHITE);
+        mark_path_to(hr, hc, parent_r, parent_c);
+        print_maze(maze, 0);
+        wait_for_enter();
+    }
+
+    multi_source_bfs(num_exits, exits_r, exits_c, 1, dist, owner, parent_r, parent_c, 0);
+
+    for (k = 0; k < num_exits; k++) {
+        served[k] = 0;
+        farthest[k] = 0;
+    }
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            view[i][j] = maze[i][j] == 'b' ? '*' : maze[i][j];
+            if (maze[i][j] == '#' || maze[i][j] == 'E') continue;
+            if (owner[i][j] != -1 && maze[i][j] != 'S') view[i][j] = exit_symbol(owner[i][j]);
+            if (owner[i][j] == -1) {
+                unreachable++;
+                continue;
+            }
+            k = owner[i][j];
+            served[k]++;
+            if (dist[i][j] > farthest[k]) farthest[k] = dist[i][j];
+        }
+        view[i][cols] = '\0';
+    }
+
+    print_maze(view, 0);
+    set_color(YELLOW);
+    printf("Nearest-exit map (each open cell shows the exit it evacuates to):\n");
+    set_color(WHITE);
+    for (k = 0; k < num_exits; k++) {
+        printf("  Exit %c at (%d, %d): %d cells, farthest %d steps\n",
+            exit_symbol(k), exits_r[k], exits_c[k], served[k], farthest[k]);
+    }
+    if (unreachable > 0) {
+        set_color(RED);
+        printf("  %d open cells cannot reach any exit.\n", unreachable);
+        set_color(WHITE);
+    }
+    wait_for_enter();
+}
+
+/** @} */
+
+/**
+ * @defgroup PathDAG Shortest-Path DAG & Path Counting
+ * @{
+ */
+
+ /**
+  * @brief Runs the BFS from 'S' and the backward BFS from 'E' concurrently on two threads.
+  * @details Fills dist_from_s/order_from_s and dist_from_e/order_from_e.
+  * @return Number of cells reached from 'S'
+  */
+int bfs_both_ends(void) {
+    BfsJob jobs[2];
+
+    jobs[0].src_r = sr;
+    jobs[0].src_c = sc;
+    jobs[0].backward = 0;
+    jobs[0].dist = dist_from_s;
+    jobs[0].order = order_from_s;
+    jobs[1].src_r = er;
+    jobs[1].src_c = ec;
+    jobs[1].backward = 1;
+    jobs[1].dist = dist_from_e;
+    jobs[1].order = order_from_e;
+
+    run_workers(bfs_job_worker, jobs, sizeof(BfsJob), 2);
+    return jobs[0].count;
+}
+
+/**
+ * @brief Adds the big number b to a (both nl base-1e9 limbs, least significant first).
+ * @details The caller guarantees the sum fits, so the final carry is dropped.
+ */
+void big_add(unsigned int* a, const unsigned int* b, int nl) {
+    unsigned int carry = 0;
+    int i;
+    for (i = 0; i < nl; i++) {
+        unsigned int sum = a[i] + b[i] + carry;
+        carry = sum >= 1000000000u;
+        a[i] = carry ? sum - 1000000000u : sum;
+    }
+}
+
+/**
+ * @brief Prints a big number stored as nl base-1e9 limbs.
+ */
+void big_print(const unsigned int* a, int nl) {
+    int i = nl - 1;
+    while (i > 0 && a[i] == 0) i--;
+    printf("%u", a[i]);
+    for (i--; i >= 0; i--) {
+        printf("%09u", a[i]);
+    }
+}
+
+/**
+ * @brief Marks every cell on some shortest S-E path and counts the distinct shortest paths.
+ * @details A cell v lies on a shortest path exactly when dS(v) + dE(v) = dS(E). The
+ *          count is a DP over the BFS layers from 'S': each DAG cell sums the counts of
+ *          its DAG neighbours one layer closer to 'S'. Only two layers of counts are kept,
+ *          and the limb count grows whenever the previous layer's top limb is in use,
+ *          so the numbers never overflow.
+ */
+void shortest_path_dag(void) {
+    static int layer_pos[MAXR][MAXC];
+    unsigned int* prev = NULL;
+    unsigned int* cur = NULL;
+    int prev_n = 0, nl = 1;
+    int dag_cells = 0, narrowest = INT_MAX, widest = 0;
+    int reached, total, head, i;
+
+    if (!same_component(sr, sc, er, ec)) {
+        set_color(RED);
+        printf("No path exists!\n");
+        set_color(WHITE);
+        return;
+    }
+
+    reached = bfs_both_ends();
+    total = dist_from_s[er][ec];
+
+    prev = (unsigned int*)calloc(1, sizeof(unsigned int));
+    if (prev == NULL) {
+        set_color(RED);
+        printf("Not enough memory to count the shortest paths!\n");
+        set_color(WHITE);
+        wait_for_enter();
+        return;
+    }
+    prev[0] = 1;                    // the single cell 'S' at layer 0
+    layer_pos[sr][sc] = 0;
+    prev_n = 1;
+    dag_cells = 1;
+    narrowest = 1;
+    widest = 1;
+
+    head = 1;
+    while (head < reached && dist_from_s[order_from_s[head] / MAXC][order_from_s[head] % MAXC] <= total) {
+        int layer = dist_from_s[order_from_s[head] / MAXC][order_from_s[head] % MAXC];
+        int tail = head, n = 0;
+
+        while (tail < reached && dist_from_s[order_from_s[tail] / MAXC][order_from_s[tail] % MAXC] == layer) {
+            int r = order_from_s[tail] / MAXC, c = order_from_s[tail] % MAXC;
+            if (dist_from_e[r][c] != -1 && layer + dist_from_e[r][c] == total) {
+                layer_pos[r][c] = n++;
+            }
+            tail++;
+        }
+
+        for (i = 0; i < prev_n; i++) {
+            if (prev[(size_t)i * nl + nl - 1] != 0) break;
+        }
+        if (i < prev_n) {           // make room for one more limb before summing
+            unsigned int* grown = (unsigned int*)calloc((size_t)prev_n * (nl + 1), sizeof(unsigned int));
+            if (grown == NULL) break;
+            for (i = 0; i < prev_n; i++) {
+                memcpy(grown + (size_t)i * (nl + 1), prev + (size_t)i * nl, nl * sizeof(unsigned int));
+            }
+            free(prev);
+            prev = grown;
+            nl++;
+        }
+
+        free(cur);
+        cur = (unsigned int*)calloc((size_t)(n > 0 ? n : 1) * nl, sizeof(unsigned int));
+        if (cur == NULL) break;
+
+        for (i = head; i < tail; i++) {
+            int r = order_from_s[i] / MAXC, c = order_from_s[i] % MAXC;
+            if (dist_from_e[r][c] == -1 || layer + dist_from_e[r][c] != total) continue;
+
+            int d;
+            for (d = 0; d < NUM_MOVES; d++) {
+                int nr, nc;
+                if (!prev_cell(r, c, d, &nr, &nc)) continue;
+                if (!is_valid(nr, nc)) continue;
+                if (dist_from_s[nr][nc] != layer - 1) continue;
+                if (dist_from_e[nr][nc] != dist_from_e[r][c] + 1) continue;
+                big_add(cur + (size_t)layer_pos[r][c] * nl, prev + (size_t)layer_pos[nr][nc] * nl, nl);
+            }
+            if (maze[r][c] != 'S' && maze[r][c] != 'E') maze[r][c] = '+';
+        }
+
+        dag_cells += n;
+        if (n < narrowest) narrowest = n;
+        if (n > widest) widest = n;
+
+        unsigned int* t = prev;
+        prev = cur;
+        cur = t;
+        prev_n = n;
+        head = tail;
+    }
+    if (head < reached && dist_from_s[order_from_s[head] / MAXC][order_from_s[head] % MAXC] <= total) {
+        set_color(RED);
+        printf("Not enough memory to count the shortest paths!\n");
+        set_color(WHITE);
+        free(prev);
+        free(cur);
+        wait_for_enter();
+        return;
+    }
+
+    print_maze(maze, 0);
+    set_color(YELLOW);
+    printf("Shortest path length: %d steps\n", total);
+    printf("Cells on some shortest path: %d (layer width %d to %d)\n", dag_cells, narrowest, widest);
+    printf("Distinct shortest paths: ");
+    big_print(prev, nl);            // the last layer holds only 'E'
+    printf("\n");
+    set_color(WHITE);
+
+    free(prev);
+    free(cur);
+    wait_for_enter();
+}
+
+/** @} */
+
+/**
+ * @defgroup Dominators Chokepoint Analysis (Dominator Tree)
+ * @{
+ */
+
+ /**
+  * @brief Numbers the cells reachable from 'S' in DFS postorder.
+  * @details Iterative DFS with an explicit stack of (cell, next direction), so deep
+  *          corridors cannot overflow the call stack.
+  * @param stack Scratch buffer of QSIZE cell indices
+  * @param next_dir Scratch buffer of QSIZE direction counters
+  * @return Number of cells numbered ('S' gets the highest number)
+  */
+int number_postorder(int* stack, int* next_dir) {
+    int top = 0, count = 0;
+    int i, j;
+
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            post_num[i][j] = -1;
+        }
+    }
+
+    stack[0] = sr * MAXC + sc;
+    next_dir[0] = 0;
+    post_num[sr][sc] = -2;          // on the stack, not numbered yet
+
+    while (top >= 0) {
+        int cr = stack[top] / MAXC, cc = stack[top] % MAXC;
+        if (next_dir[top] == NUM_MOVES) {
+            post_num[cr][cc] = count;
+            post_cell[count++] = stack[top];
+            top--;
+            continue;
+        }
+
+        int d = next_dir[top]++;
+        int nr, nc;
+        if (!neighbor_cell(cr, cc, d, &nr, &nc)) continue;
+        if (!is_valid(nr, nc) || post_num[nr][nc] != -1) continue;
+
+        post_num[nr][nc] = -2;
+        top++;
+        stack[top] = nr * MAXC + nc;
+        next_dir[top] = 0;
+    }
+    return count;
+}
+
+/**
+ * @brief Walks two dominator-tree fingers up until they meet (Cooper-Harvey-Kennedy).
+ * @param a Postorder number of the first node
+ * @param b Postorder number of the second node
+ * @return Postorder number of the nearest common dominator
+ */
+int dom_intersect(int a, int b) {
+    while (a != b) {
+        while (a < b) a = idom[a];
+        while (b < a) b = idom[b];
+    }
+    return a;
+}
+
+/**
+ * @brief Builds the dominator tree of the grid graph rooted at 'S'.
+ * @details Iterative Cooper-Harvey-Kennedy algorithm: nodes are visited in reverse
+ *          postorder and each immediate dominator becomes the intersection of its
+ *          processed predecessors, repeated until nothing changes. On grid graphs
+ *          this settles after a handful of passes.
+ * @return Number of cells reachable from 'S'
+ */
+int build_dominator_tree(void) {
+    static int stack[QSIZE], next_dir[QSIZE];
+    int n = number_postorder(stack, next_dir);
+    int changed = 1;
+    int i;
+
+    for (i = 0; i < n; i++) idom[i] = -1;
+    idom[n - 1] = n - 1;            // 'S' dominates itself
+
+    while (changed) {
+        changed = 0;
+        for (i = n - 2; i >= 0; i--) {
+            int cr = post_cell[i] / MAXC, cc = post_cell[i] % MAXC;
+            int new_idom = -1;
+
+            int d;
+            for (d = 0; d < NUM_MOVES; d++) {
+                int nr, nc;
+                if (!prev_cell(cr, cc, d, &nr, &nc)) continue;
+                if (!is_valid(nr, nc)) continue;
+
+                int p = post_num[nr][nc];
+                if (p < 0 || idom[p] == -1) continue;
+                new_idom = new_idom == -1 ? p : dom_intersect(p, new_idom);
+            }
+
+            if (new_idom != idom[i]) {
+                idom[i] = new_idom;
+                changed = 1;
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Marks the cells that every path from 'S' to 'E' must cross.
+ * @details These are exactly the dominator-tree ancestors of 'E' other than 'S'.
+ *          They are drawn as '!' and listed after the maze.
+ */
+void show_chokepoints(void) {
+    int count = 0;
+    int x;
+
+    if (!same_component(sr, sc, er, ec)) {
+        set_color(RED);
+        printf("No path exists!\n");
+        set_color(WHITE);
+        return;
+    }
+
+    int n = build_dominator_tree();
+    for (x = idom[post_num[er][ec]]; x != n - 1; x = idom[x]) {
+        maze[post_cell[x] / MAXC][post_cell[x] % MAXC] = '!';
+        count++;
+    }
+
+    print_maze(maze, 0);
+    set_color(YELLOW);
+    if (count == 0) {
+        printf("No chokepoints: every cell between S and E can be bypassed.\n");
+    }
+    else {
+        printf("%d chokepoint cell(s) lie on every path from S to E (marked '!').\n", count);
+    }
+    set_color(WHITE);
+    wait_for_enter();
+}
+
+/** @} */
+
+/**
+ * @defgroup WallRemoval Best Single Wall Removal
+ * @{
+ */
+
+ /**
+  * @brief Work item for scoring the walls in one strip of rows.
+  */
+typedef struct {
+    int r0, r1;                 /**< Rows [r0, r1) scored by this strip */
+    int count;                  /**< Number of entries in the top list */
+    int wr[WALL_TOP_K];         /**< Rows of the best walls, best first */
+    int wc[WALL_TOP_K];         /**< Columns of the best walls, best first */
+    int len[WALL_TOP_K];        /**< S-E path length after removing each wall */
+} WallStrip;
+
+/**
+ * @brief Inserts a wall into a strip's sorted top list if it is good enough.
+ * @details Ties keep the earlier wall in reading order, so results do not depend on strips.
+ */
+void wall_top_insert(WallStrip* top, int r, int c, int len) {
+    int i = top->count;
+    if (i == WALL_TOP_K) {
+        if (len >= top->len[WALL_TOP_K - 1]) return;
+        i--;
+    }
+    else {
+        top->count++;
+    }
+    while (i > 0 && top->len[i - 1] > len) {
+        top->wr[i] = top->wr[i - 1];
+        top->wc[i] = top->wc[i - 1];
+        top->len[i] = top->len[i - 1];
+        i--;
+    }
+    top->wr[i] = r;
+    top->wc[i] = c;
+    top->len[i] = len;
+}
+
+/**
+ * @brief Thread body: scores every wall of a strip using dist_from_s and dist_from_e.
+ * @details Removing wall w allows the route S..a, w, b..E, where a moves onto w and b
+ *          is where a move from w ends, so its score is min dS(a) + min dE(b) + 2.
+ */
+THREAD_FUNC(wall_score_worker) {
+    WallStrip* top = (WallStrip*)arg;
+    int r, c, d;
+
+    top->count = 0;
+    for (r = top->r0; r < top->r1; r++) {
+        for (c = 0; c < cols; c++) {
+            if (maze[r][c] != '#') continue;
+
+            int best_s = -1, best_e = -1;
+            for (d = 0; d < NUM_MOVES; d++) {
+                int nr, nc;
+                if (prev_cell(r, c, d, &nr, &nc) && is_valid(nr, nc) && dist_from_s[nr][nc] != -1
+                    && (best_s == -1 || dist_from_s[nr][nc] < best_s)) best_s = dist_from_s[nr][nc];
+                if (neighbor_cell(r, c, d, &nr, &nc) && is_valid(nr, nc) && dist_from_e[nr][nc] != -1
+                    && (best_e == -1 || dist_from_e[nr][nc] < best_e)) best_e = dist_from_e[nr][nc];
+            }
+            if (best_s != -1 && best_e != -1) {
+                wall_top_insert(top, r, c, best_s + best_e + 2);
+            }
+        }
+    }
+    THREAD_RETURN;
+}
+
+/**
+ * @brief Reports the walls whose removal shortens the S-E path the most.
+ * @details Costs two BFS runs (from 'S' and from 'E', concurrently) plus one parallel
+ *          scan over the walls, instead of one BFS per wall. The best WALL_TOP_K walls
+ *          that actually help are drawn as '%'.
+ */
+void best_wall_removal(void) {
+    WallStrip strips[MAX_THREADS];
+    WallStrip best;
+    int nstrips = strip_count();
+    int current, i, k;
+
+    bfs_both_ends();
+    current = dist_from_s[er][ec];
+
+    for (i = 0; i < nstrips; i++) {
+        strips[i].r0 = rows * i / nstrips;
+        strips[i].r1 = rows * (i + 1) / nstrips;
+    }
+    run_workers(wall_score_worker, strips, sizeof(WallStrip), nstrips);
+
+    best.count = 0;
+    for (i = 0; i < nstrips; i++) {         // strips are in reading order, so ties stay stable
+        for (k = 0; k < strips[i].count; k++) {
+            if (current == -1 || strips[i].len[k] < current) {
+                wall_top_insert(&best, strips[i].wr[k], strips[i].wc[k], strips[i].len[k]);
+            }
+        }
+    }
+
+    for (k = 0; k < best.count; k++) {
+        maze[best.wr[k]][best.wc[k]] = '%';
+    }
+    print_maze(maze, 0);
+
+    set_color(YELLOW);
+    if (current == -1) printf("Currently no path exists from S to E.\n");
+    else printf("Current shortest path: %d steps\n", current);
+    set_color(WHITE);
+
+    if (best.count == 0) {
+        set_color(RED);
+        printf("No single wall removal makes the path shorter.\n");
+        set_color(WHITE);
+    }
+    for (k = 0; k < best.count; k++) {
+        printf("  #%d: wall at (%d, %d) -> %d steps", k + 1, best.wr[k], best.wc[k], best.len[k]);
+        if (current != -1) printf(" (saves %d)", current - best.len[k]);
+        printf("\n");
+    }
+    wait_for_enter();
+}
+
+/** @} */
+
+/**
+ * @defgroup WallBreaks Shortest Path Through Up To k Walls
+ * @{
+ */
+
+ /**
+  * @brief BFS over (cell, breaks left) states, where stepping onto '#' uses one break.
+  * @details States are packed as cell index * 16 + breaks left. A cell is only
+  *          re-entered with strictly more breaks left than any earlier visit, so a
+  *          single byte per cell replaces k + 1 visited maps and each cell is queued
+  *          at most k + 1 times. The queue is never wrapped, so every entry keeps the
+  *          position of its parent for path reconstruction.
+  * @param k Number of walls that may be broken
+  * @return Queue position of the state that reached 'E', or -1
+  */
+int bfs_with_breaks(int k) {
+    int head = 0, tail = 0;
+    int i, j;
+
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            best_left[i][j] = -1;
+        }
+    }
+
+    best_left[sr][sc] = (signed char)k;
+    break_state[tail] = (sr * MAXC + sc) * 16 + k;
+    break_parent[tail] = -1;
+    tail++;
+
+    while (head < tail) {
+        int cell = break_state[head] / 16, left = break_state[head] % 16;
+        int cr = cell / MAXC, cc = cell % MAXC;
+        if (cr == er && cc == ec) return head;
+
+        int d;
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!neighbor_cell(cr, cc, d, &nr, &nc)) continue;
+
+            int nleft = maze[nr][nc] == '#' ? left - 1 : left;
+            if (nleft < 0 || nleft <= best_left[nr][nc]) continue;
+
+            best_left[nr][nc] = (signed char)nleft;
+            break_state[tail] = (nr * MAXC + nc) * 16 + nleft;
+            break_parent[tail] = head;
+            tail++;
+        }
+        head++;
+    }
+    return -1;
+}
+
+/**
+ * @brief Asks for k and shows the shortest path that may pass through up to k walls.
+ * @details Open path cells are marked 'b' and broken walls '%'.
+ */
+void shortest_with_breaks(void) {
+    int k = 0, broken = 0, length = 0;
+    int x;
+
+    set_color(CYAN);
+    printf("How many walls may be broken (0-%d)? ", MAX_WALL_BREAKS);
+    set_color(WHITE);
+    scanf("%d", &k);
+    skip_line();
+    if (k < 0 || k > MAX_WALL_BREAKS) {
+        set_color(RED);
+        printf("k must be between 0 and %d!\n", MAX_WALL_BREAKS);
+        set_color(WHITE);
+        return;
+    }
+
+    int goal = bfs_with_breaks(k);
+    if (goal == -1) {
+        set_color(RED);
+        printf("No path exists even when breaking %d wall(s)!\n", k);
+        set_color(WHITE);
+        wait_for_enter();
+        return;
+    }
+
+    for (x = break_parent[goal]; break_parent[x] != -1; x = break_parent[x]) {
+        int cell = break_state[x] / 16;
+        char* ch = &maze[cell / MAXC][cell % MAXC];
+        if (*ch == '#') {
+            *ch = '%';
+            broken++;
+        }
+        else {
+            *ch = 'b';
+        }
+    }
+    for (x = goal; break_parent[x] != -1; x = break_parent[x]) length++;
+
+    print_maze(maze, 0);
+    set_color(YELLOW);
+    printf("Shortest path with up to %d break(s): %d steps, %d wall(s) broken (marked '%%').\n",
+        k, length, broken);
+    set_color(WHITE);
+    wait_for_enter();
+}
+
+/** @} */
+
+/**
+ * @defgroup Waypoints Waypoint Routing (Held-Karp)
+ * @{
+ */
+
+ /**
+  * @brief Marks the shortest path from a BFS source to a target cell.
+  * @details Walks down the distance field from the target, so no parent map is needed.
+  * @param dist Distance field of a BFS from the segment's first cell
+  * @param tr Row of the target cell
+  * @param tc Column of the target cell
+  */
+void mark_segment(int dist[MAXR][MAXC], int tr, int tc) {
+    int cr = tr, cc = tc;
+    while (dist[cr][cc] > 0) {
+        int d;
+        int nr = cr, nc = cc;
+        for (d = 0; d < NUM_MOVES; d++) {
+            if (!prev_cell(cr, cc, d, &nr, &nc)) continue;
+            if (is_valid(nr, nc) && dist[nr][nc] == dist[cr][cc] - 1) break;
+        }
+        cr = nr;
+        cc = nc;
+        if (maze[cr][cc] == '*' || maze[cr][cc] == ' ' || (maze[cr][cc] >= '0' && maze[cr][cc] <= '9')) {
+            maze[cr][cc] = 'b';
+        }
+    }
+}
+
+/**
+ * @brief Finds the shortest route from 'S' through every 'K' waypoint to 'E'.
+ * @details One BFS per waypoint (plus one from 'S') runs on its own thread to fill the
+ *          distance matrix. A bitmask Held-Karp DP then picks the best visiting order:
+ *          dp[mask][j] is the shortest walk from 'S' covering the waypoints in mask and
+ *          ending at waypoint j. Unused entries hold a large sentinel instead of being
+ *          skipped, so the inner minimum over predecessors is a branch-free loop the
+ *          compiler can vectorize.
+ */
+void waypoint_route(void) {
+    const int INF = INT_MAX / 4;
+    int wr[MAX_WAYPOINTS], wc[MAX_WAYPOINTS];
+    int w[MAX_WAYPOINTS][MAX_WAYPOINTS];
+    int from_s[MAX_WAYPOINTS], to_e[MAX_WAYPOINTS];
+    int route[MAX_WAYPOINTS];
+    BfsJob* jobs;
+    int (*dist)[MAXR][MAXC];
+    int* order;
+    int* dp;
+    int m = 0, i, j;
+    unsigned int mask, full;
+    clock_t started = clock();
+
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            if (maze[i][j] != 'K') continue;
+            if (m == MAX_WAYPOINTS) {
+                set_color(RED);
+                printf("Too many waypoints (at most %d)!\n", MAX_WAYPOINTS);
+                set_color(WHITE);
+                wait_for_enter();
+                return;
+            }
+            wr[m] = i;
+            wc[m] = j;
+            m++;
+        }
+    }
+
+    // Job m is the BFS from 'S'; jobs 0..m-1 start at the waypoints.
+    jobs = (BfsJob*)malloc((m + 1) * sizeof(BfsJob));
+    dist = (int (*)[MAXR][MAXC])malloc((m + 1) * sizeof(*dist));
+    order = (int*)malloc((size_t)(m + 1) * QSIZE * sizeof(int));
+    if (jobs == NULL || dist == NULL || order == NULL) {
+        set_color(RED);
+        printf("Not enough memory for %d waypoints!\n", m);
+        set_color(WHITE);
+        free(jobs);
+        free(dist);
+        free(order);
+        wait_for_enter();
+        return;
+    }
+    for (i = 0; i <= m; i++) {
+        jobs[i].src_r = i < m ? wr[i] : sr;
+        jobs[i].src_c = i < m ? wc[i] : sc;
+        jobs[i].backward = 0;
+        jobs[i].dist = dist[i];
+        jobs[i].order = order + (size_t)i * QSIZE;
+    }
+    run_workers(bfs_job_worker, jobs, sizeof(BfsJob), m + 1);
+
+    for (i = 0; i < m; i++) {
+        from_s[i] = dist[m][wr[i]][wc[i]] == -1 ? INF : dist[m][wr[i]][wc[i]];
+        to_e[i] = dist[i][er][ec] == -1 ? INF : dist[i][er][ec];
+        for (j = 0; j < m; j++) {
+            w[i][j] = dist[i][wr[j]][wc[j]] == -1 ? INF : dist[i][wr[j]][wc[j]];
+        }
+    }
+
+    int best = INF, last = -1;
+    full = (1u << m) - 1;
+    dp = NULL;
+    if (m == 0) {
+        best = dist[0][er][ec] == -1 ? INF : dist[0][er][ec];
+    }
+    else {
+        dp = (int*)malloc(((size_t)full + 1) * m * sizeof(int));
+        if (dp == NULL) {
+            set_color(RED);
+            printf("Not enough memory for %d waypoints!\n", m);
+            set_color(WHITE);
+            free(jobs);
+            free(dist);
+            free(order);
+            wait_for_enter();
+            return;
+        }
+        for (j = 0; j < m; j++) dp[j] = INF;
+        for (mask = 1; mask <= full; mask++) {
+            int* row = dp + (size_t)mask * m;
+            for (j = 0; j < m; j++) {
+                if (!(mask & (1u << j))) {
+                    row[j] = INF;
+                    continue;
+                }
+                unsigned int prev_mask = mask ^ (1u << j);
+                if (prev_mask == 0) {
+                    row[j] = from_s[j];
+                    continue;
+                }
+                const int* prev = dp + (size_t)prev_mask * m;
+                int b = INF;
+                for (i = 0; i < m; i++) {
+                    int v = prev[i] + w[i][j];
+                    b = v < b ? v : b;
+                }
+                row[j] = b < INF ? b : INF;
+            }
+        }
+        for (j = 0; j < m; j++) {
+            int* row = dp + (size_t)full * m;
+            if (row[j] + to_e[j] < best) {
+                best = row[j] + to_e[j];
+                last = j;
+            }
+        }
+    }
+
+    if (best >= INF) {
+        set_color(RED);
+        printf("No route visits every waypoint and reaches the exit!\n");
+        set_color(WHITE);
+        free(dp);
+        free(jobs);
+        free(dist);
+        free(order);
+        wait_for_enter();
+        return;
+    }
+
+    // Walk the DP back from the last waypoint to recover the visiting order.
+    mask = full;
+    for (i = m - 1; i >= 0; i--) {
+        route[i] = last;
+        unsigned int prev_mask = mask ^ (1u << last);
+        int cur = dp[(size_t)mask * m + last];
+        mask = prev_mask;
+        if (prev_mask == 0) break;
+        for (j = 0; j < m; j++) {
+            if ((prev_mask & (1u << j)) && dp[(size_t)prev_mask * m + j] + w[j][last] == cur) break;
+        }
+        last = j;
+    }
+
+    if (m == 0) {
+        mark_segment(dist[0], er, ec);
+    }
+    else {
+        mark_segment(dist[m], wr[route[0]], wc[route[0]]);
+        for (i = 1; i < m; i++) {
+            mark_segment(dist[route[i - 1]], wr[route[i]], wc[route[i]]);
+        }
+        mark_segment(dist[route[m - 1]], er, ec);
+    }
+
+    print_maze(maze, 0);
+    set_color(YELLOW);
+    printf("Shortest route through %d waypoint(s): %d steps (%.3f s)\n",
+        m, best, (double)(clock() - started) / CLOCKS_PER_SEC);
+    set_color(WHITE);
+    if (m > 0) {
+        printf("Visiting order: S");
+        for (i = 0; i < m; i++) printf(" -> K(%d, %d)", wr[route[i]], wc[route[i]]);
+        printf(" -> E\n");
+    }
+
+    free(dp);
+    free(jobs);
+    free(dist);
+    free(order);
+    wait_for_enter();
+}
+
+/** @} */
+
+/**
+ * @defgroup KeysDoors Keys & Doors (BFS Over Key Masks)
+ * @{
+ */
+
+#define STATE_NONE 0xFFFFFFFFu      /**< Empty slot marker of the visited-state hash set */
+
+/**
+ * @brief Open-addressing hash set of packed (cell, key mask) states.
+ * @details Sized to the states actually reached rather than to cells * 2^keys;
+ *          the table doubles whenever it becomes half full.
+ */
+typedef struct {
+    unsigned int* slot;         /**< Packed states, STATE_NONE when empty */
+    size_t cap;                 /**< Number of slots (a power of two) */
+    size_t size;                /**< Number of stored states */
+} StateSet;
+
+/**
+ * @brief Mixes the bits of a packed state into a table position.
+ */
+size_t state_hash(unsigned int x, size_t cap) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x & (cap - 1);
+}
+
+/**
+ * @brief Inserts a state into the set.
+ * @details If the table cannot grow, the set is left as it was.
+ * @return 1 if the state was new, 0 if it was already present, -1 if out of memory
+ */
+int state_set_add(StateSet* set, unsigned int x) {
+    size_t i;
+    if (2 * (set->size + 1) > set->cap) {
+        StateSet bigger;
+        bigger.cap = set->cap * 2;
+        bigger.size = 0;
+        bigger.slot = (unsigned int*)malloc(bigger.cap * sizeof(unsigned int));
+        if (bigger.slot == NULL) return -1;
+        memset(bigger.slot, 0xFF, bigger.cap * sizeof(unsigned int));
+        for (i = 0; i < set->cap; i++) {
+            if (set->slot[i] != STATE_NONE) state_set_add(&bigger, set->slot[i]);
+        }
+        free(set->slot);
+        *set = bigger;
+    }
+    for (i = state_hash(x, set->cap); set->slot[i] != STATE_NONE; i = (i + 1) & (set->cap - 1)) {
+        if (set->slot[i] == x) return 0;
+    }
+    set->slot[i] = x;
+    set->size++;
+    return 1;
+}
+
+/**
+ * @brief Shortest path from 'S' to 'E' where doors open only while their key is held.
+ * @details BFS over (cell, keys held) states packed as cell index * 2^16 + mask into
+ *          one 32-bit word. Visited states live in a StateSet, and the queue is a
+ *          growable array of packed states whose parallel parent array allows the
+ *          route to be drawn.
+ */
+void keys_and_doors(void) {
+    StateSet seen;
+    unsigned int* queue;
+    int* parent;
+    size_t qcap = 1024, head = 0, tail = 0;
+    long goal = -1;
+    int out_of_memory = 0;
+
+    if (num_key_types > MAX_KEY_TYPES) {
+        set_color(RED);
+        printf("Too many key types (at most %d)!\n", MAX_KEY_TYPES);
+        set_color(WHITE);
+        wait_for_enter();
+        return;
+    }
+
+    seen.cap = 1024;
+    seen.size = 0;
+    seen.slot = (unsigned int*)malloc(seen.cap * sizeof(unsigned int));
+    queue = (unsigned int*)malloc(qcap * sizeof(unsigned int));
+    parent = (int*)malloc(qcap * sizeof(int));
+    if (seen.slot == NULL || queue == NULL || parent == NULL) {
+        set_color(RED);
+        printf("Not enough memory for the key search!\n");
+        set_color(WHITE);
+        free(seen.slot);
+        free(queue);
+        free(parent);
+        wait_for_enter();
+        return;
+    }
+    memset(seen.slot, 0xFF, seen.cap * sizeof(unsigned int));
+
+    queue[tail] = (unsigned int)(sr * MAXC + sc) << MAX_KEY_TYPES;
+    parent[tail] = -1;
+    state_set_add(&seen, queue[tail]);
+    tail++;
+
+    while (head < tail && !out_of_memory) {
+        unsigned int state = queue[head];
+        int cell = (int)(state >> MAX_KEY_TYPES);
+        int keys = (int)(state & ((1u << MAX_KEY_TYPES) - 1));
+        int cr = cell / MAXC, cc = cell % MAXC;
+
+        if (maze[cr][cc] == 'E') {
+            goal = (long)head;
+            break;
+        }
+
+        int d;
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!neighbor_cell(cr, cc, d, &nr, &nc)) continue;
+            if (!is_valid(nr, nc)) continue;
+
+            char ch = maze[nr][nc];
+            if (is_door(ch) && !door_open(ch, keys)) continue;
+
+            int nkeys = keys;
+            if (is_key(ch)) nkeys |= 1 << key_bit[ch - 'a'];
+
+            unsigned int next = ((unsigned int)(nr * MAXC + nc) << MAX_KEY_TYPES) | (unsigned int)nkeys;
+            int added = state_set_add(&seen, next);
+            if (added == 0) continue;
+
+            if (added > 0 && tail == qcap) {
+                unsigned int* grown_queue = (unsigned int*)realloc(queue, qcap * 2 * sizeof(unsigned int));
+                if (grown_queue != NULL) queue = grown_queue;
+                int* grown_parent = grown_queue ? (int*)realloc(parent, qcap * 2 * sizeof(int)) : NULL;
+                if (grown_parent != NULL) {
+                    parent = grown_parent;
+                    qcap *= 2;
+                }
+                else added = -1;
+            }
+            if (added < 0) {
+                out_of_memory = 1;
+                break;
+            }
+            queue[tail] = next;
+            parent[tail] = (int)head;
+            tail++;
+        }
+        head++;
+    }
+
+    if (out_of_memory) {
+        set_color(RED);
+        printf("Not enough memory for the key search after %lu states!\n", (unsigned long)seen.size);
+        set_color(WHITE);
+    }
+    else if (goal == -1) {
+        set_color(RED);
+        printf("No path exists! The exit cannot be reached with the available keys.\n");
+        set_color(WHITE);
+    }
+    else {
+        int length = 0;
+        long x;
+        for (x = goal; parent[x] != -1; x = parent[x]) {
+            int cell = (int)(queue[x] >> MAX_KEY_TYPES);
+            char* ch = &maze[cell / MAXC][cell % MAXC];
+            if (*ch == '*' || *ch == ' ' || (*ch >= '0' && *ch <= '9')) *ch = 'b';
+            length++;
+        }
+        print_maze(maze, 0);
+        set_color(YELLOW);
+        printf("Shortest path collecting keys: %d steps\n", length);
+        set_color(WHITE);
+    }
+    printf("States explored: %lu (%d key types), visited set %lu KB, queue %lu KB\n",
+        (unsigned long)seen.size, num_key_types,
+        (unsigned long)(seen.cap * sizeof(unsigned int) / 1024),
+        (unsigned long)(qcap * (sizeof(unsigned int) + sizeof(int)) / 1024));
+
+    free(seen.slot);
+    free(queue);
+    free(parent);
+    wait_for_enter();
+}
+
+/** @} */
+
+/**
+ * @defgroup AStar Portal-Aware A* Search
+ * @{
+ */
+
+ /**
+  * @brief Manhattan distance between two cells (measured around the torus in wrap mode).
+  */
+int manhattan(int r1, int c1, int r2, int c2) {
+    int dy = abs(r1 - r2), dx = abs(c1 - c2);
+    if (wrap_mode) {
+        if (rows - dy < dy) dy = rows - dy;
+        if (cols - dx < dx) dx = cols - dx;
+    }
+    return dy + dx;
+}
+
+/**
+ * @brief Returns the cell index of portal end k (ends 2i and 2i + 1 form pair i).
+ */
+int portal_end(int k) {
+    return k % 2 == 0 ? portal_a[k / 2] : portal_b[k / 2];
+}
+
+/**
+ * @brief Precomputes, for each portal end, a lower bound on the distance from its partner to 'E'.
+ * @details The bound of end k is the relaxed distance from partner(k) to 'E' where
+ *          walking between two cells costs their Manhattan distance and stepping onto
+ *          a portal end moves you to its partner at no extra cost. With at most
+ *          MAX_PORTALS pairs, a Bellman-Ford pass settles it.
+ */
+void compute_portal_bounds(void) {
+    int n = 2 * num_portals;
+    int dist_to_e[2 * MAX_PORTALS];
+    int changed = 1;
+    int j, k;
+
+    for (k = 0; k < n; k++) {
+        int p = portal_end(k);
+        dist_to_e[k] = manhattan(p / MAXC, p % MAXC, er, ec);
+    }
+    while (changed) {
+        changed = 0;
+        for (k = 0; k < n; k++) {
+            int p = portal_end(k);
+            for (j = 0; j < n; j++) {
+                int q = portal_end(j);
+                int via = manhattan(p / MAXC, p % MAXC, q / MAXC, q % MAXC) + dist_to_e[j ^ 1];
+                if (via < dist_to_e[k]) {
+                    dist_to_e[k] = via;
+                    changed = 1;
+                }
+            }
+        }
+    }
+    for (k = 0; k < n; k++) {
+        portal_bound[k] = dist_to_e[k ^ 1];
+    }
+}
+
+/**
+ * @brief Admissible and consistent A* heuristic that knows about portals.
+ * @details Either walk straight to 'E', or walk onto some portal end and continue from its partner.
+ */
+int astar_h(int r, int c) {
+    int h = manhattan(r, c, er, ec);
+    int k;
+    for (k = 0; k < 2 * num_portals; k++) {
+        int p = portal_end(k);
+        int via = manhattan(r, c, p / MAXC, p % MAXC) + portal_bound[k];
+        if (via < h) h = via;
+    }
+    return h;
+}
+
+/**
+ * @brief Tells whether heap entry a should be expanded before entry b (lower f, then higher g).
+ */
+int heap_before(int a, int b) {
+    if (heap_f[a] != heap_f[b]) return heap_f[a] < heap_f[b];
+    return heap_g[a] > heap_g[b];
+}
+
+/**
+ * @brief Swaps two entries of the A* open list.
+ */
+void heap_swap(int a, int b) {
+    int t;
+    t = heap_f[a]; heap_f[a] = heap_f[b]; heap_f[b] = t;
+    t = heap_g[a]; heap_g[a] = heap_g[b]; heap_g[b] = t;
+    t = heap_cell[a]; heap_cell[a] = heap_cell[b]; heap_cell[b] = t;
+}
+
+/**
+ * @brief Adds a cell to the A* open list.
+ */
+void heap_push(int f, int g, int cell) {
+    int i = heap_n++;
+    heap_f[i] = f;
+    heap_g[i] = g;
+    heap_cell[i] = cell;
+    while (i > 0 && heap_before(i, (i - 1) / 2)) {
+        heap_swap(i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+/**
+ * @brief Removes the best entry of the A* open list into slot heap_n.
+ */
+void heap_pop(void) {
+    int i = 0;
+    heap_n--;
+    heap_swap(0, heap_n);
+    while (1) {
+        int best = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < heap_n && heap_before(l, best)) best = l;
+        if (r < heap_n && heap_before(r, best)) best = r;
+        if (best == i) break;
+        heap_swap(i, best);
+        i = best;
+    }
+}
+
+/**
+ * @brief Computes the shortest path with A* guided by the portal-aware heuristic.
+ * @details Uses the same neighbour expansion (portals included) as BFS and reports
+ *          how many cells were expanded, to compare against a plain BFS.
+ */
+void astar_shortest(void) {
+    static int g[MAXR][MAXC];
+    static char closed[MAXR][MAXC];
+    int parent_r[MAXR][MAXC];
+    int parent_c[MAXR][MAXC];
+    int expanded = 0, found = 0;
+    int i, j;
+
+    if (!same_component(sr, sc, er, ec)) {
+        set_color(RED);
+        printf("No path exists!\n");
+        set_color(WHITE);
+        return;
+    }
+
+    compute_portal_bounds();
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            g[i][j] = INT_MAX;
+            closed[i][j] = 0;
+        }
+    }
+
+    heap_n = 0;
+    g[sr][sc] = 0;
+    parent_r[sr][sc] = -1;
+    parent_c[sr][sc] = -1;
+    heap_push(astar_h(sr, sc), 0, sr * MAXC + sc);
+
+    while (heap_n > 0) {
+        heap_pop();
+        int cr = heap_cell[heap_n] / MAXC, cc = heap_cell[heap_n] % MAXC;
+        if (closed[cr][cc]) continue;
+        closed[cr][cc] = 1;
+        expanded++;
+        if (cr == er && cc == ec) {
+            found = 1;
+            break;
+        }
+
+        int d;
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!neighbor_cell(cr, cc, d, &nr, &nc)) continue;
+            if (!is_valid(nr, nc) || closed[nr][nc]) continue;
+
+            int ng = g[cr][cc] + 1;
+            if (ng >= g[nr][nc]) continue;
+
+            g[nr][nc] = ng;
+            parent_r[nr][nc] = cr;
+            parent_c[nr][nc] = cc;
+            heap_push(ng + astar_h(nr, nc), ng, nr * MAXC + nc);
+        }
+    }
+
+    if (!found) {
+        set_color(RED);
+        printf("No path exists!\n");
+        set_color(WHITE);
+        return;
+    }
+
+    set_color(YELLOW);
+    printf("A* expanded %d cells (%d portal pair(s)).\n", expanded, num_portals);
+    set_color(WHITE);
+    mark_shortest_path(parent_r, parent_c);
+    print_maze(maze, 0);
+}
+
+/** @} */
+
+/**
+ * @defgroup Building Multi-Floor 3D Mazes
+ * @{
+ */
+
+ /**
+  * @brief A multi-floor maze read straight from a memory-mapped file.
+  * @details Only the offset of each floor is kept in memory; cells are read from the
+  *          mapping on demand, so the operating system pages floors in and out lazily.
+  */
+typedef struct {
+    const char* data;           /**< Mapped file contents */
+    size_t size;                /**< File size in bytes */
+    int floors, rows, cols;     /**< Building dimensions */
+    size_t stride;              /**< Bytes per row, including the line ending */
+    size_t* floor_offset;       /**< File offset of the first row of each floor */
+    long long start, exit;      /**< Flat layer-major indices of 'S' and 'E' (-1 if missing) */
+} Building;
+
+/**
+ * @brief Returns the cell of a building at a flat layer-major index.
+ */
+char building_cell(const Building* b, long long idx) {
+    long long per_floor = (long long)b->rows * b->cols;
+    int z = (int)(idx / per_floor);
+    int r = (int)(idx % per_floor / b->cols);
+    int c = (int)(idx % b->cols);
+    return b->data[b->floor_offset[z] + (size_t)r * b->stride + c];
+}
+
+/**
+ * @brief Finds the last occurrence of a character in a row of n bytes.
+ * @return Pointer to it, or NULL if the row does not contain it
+ */
+const char* last_in_row(const char* row, size_t n, char ch) {
+    while (n > 0) {
+        if (row[--n] == ch) return row + n;
+    }
+    return NULL;
+}
+
+/**
+ * @brief Maps a building file and records where each floor starts.
+ * @details Floors are separated by blank lines and must all have the same size;
+ *          leading ';' directive lines are skipped. This single sequential pass also
+ *          locates 'S' and 'E'; like load_maze, the last of each in reading order wins.
+ * @return 1 on success, 0 on failure (error printed)
+ */
+int open_building(const char* path, Building* b) {
+    size_t pos = 0, cap = 16;
+    int row = 0;
+
+    b->data = map_file(path, &b->size);
+    if (b->data == NULL) {
+        set_color(RED);
+        printf("Error: %s cannot be mapped!\n", path);
+        set_color(WHITE);
+        return 0;
+    }
+    b->floors = b->rows = b->cols = 0;
+    b->stride = 0;
+    b->start = b->exit = -1;
+    b->floor_offset = (size_t*)malloc(cap * sizeof(size_t));
+    if (b->floor_offset == NULL) {
+        set_color(RED);
+        printf("Not enough memory to index %s!\n", path);
+        set_color(WHITE);
+        unmap_file(b->data, b->size);
+        return 0;
+    }
+
+    while (pos < b->size) {
+        const char* nl = (const char*)memchr(b->data + pos, '\n', b->size - pos);
+        size_t next = nl ? (size_t)(nl - b->data) + 1 : b->size;
+        size_t len = (nl ? (size_t)(nl - b->data) : b->size) - pos;
+        if (len > 0 && b->data[pos + len - 1] == '\r') len--;
+
+        if (len == 0) {                     // blank line: close the current floor
+            if (row > 0) {
+                if (b->floors == 1) b->rows = row;
+                else if (row != b->rows) break;
+                row = 0;
+            }
+        }
+        else if (!(b->data[pos] == ';' && b->floors == 0)) {
+            if (row == 0) {
+                if (b->floors == (int)cap) {
+                    size_t* grown = (size_t*)realloc(b->floor_offset, cap * 2 * sizeof(size_t));
+                    if (grown == NULL) {
+                        b->floors = -2;
+                        break;
+                    }
+                    b->floor_offset = grown;
+                    cap *= 2;
+                }
+                b->floor_offset[b->floors++] = pos;
+                if (b->floors == 1) {
+                    b->cols = (int)len;
+                    b->stride = next - pos;
+                }
+            }
+            if ((int)len != b->cols || pos != b->floor_offset[b->floors - 1] + row * b->stride) {
+                b->floors = -1;
+                break;
+            }
+
+            long long base = ((long long)(b->floors - 1) * (b->rows ? b->rows : row + 1) + row) * b->cols;
+            const char* hit = last_in_row(b->data + pos, len, 'S');
+            if (hit) b->start = base + (hit - (b->data + pos));
+            hit = last_in_row(b->data + pos, len, 'E');
+            if (hit) b->exit = base + (hit - (b->data + pos));
+            row++;
+        }
+        pos = next;
+    }
+    if (b->floors == 1 && row > 0) b->rows = row;
+    if (b->floors > 1 && row > 0 && row != b->rows) b->floors = -1;
+
+    if (b->floors <= 0) {
+        set_color(RED);
+        if (b->floors == -2) printf("Not enough memory to index %s!\n", path);
+        else printf("Error: every floor must have the same size and line endings!\n");
+        set_color(WHITE);
+        free(b->floor_offset);
+        unmap_file(b->data, b->size);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Reads the 4-bit move code of a building cell (0 = not reached, 7 = 'S').
+ */
+int building_via(const unsigned char* via, long long idx) {
+    return via[idx >> 1] >> ((idx & 1) * 4) & 15;
+}
+
+/**
+ * @brief Doubles a frontier of flat cell indices; the old block survives a failed realloc.
+ * @return 1 on success, 0 if out of memory
+ */
+int grow_frontier(long long** list, size_t* cap) {
+    long long* grown = (long long*)realloc(*list, *cap * 2 * sizeof(long long));
+    if (grown == NULL) return 0;
+    *list = grown;
+    *cap *= 2;
+    return 1;
+}
+
+/**
+ * @brief Finds the shortest path through a multi-floor building with a 3D BFS.
+ * @details Cells use a flat layer-major index (floor * rows + row) * cols + col, so
+ *          the six moves are fixed offsets: +-cols, +-1 on a floor and +-rows*cols
+ *          between floors. A '<' cell leads to the same spot one floor up and a '>'
+ *          cell one floor down. Per cell only four bits are kept: the move that reached
+ *          it, which doubles as the visited mark. Stairs are one-way, so level parity
+ *          alone could not rebuild the path. The BFS runs level by level and only holds
+ *          the current and next frontier; the floors themselves stay in the mapping.
+ */
+void solve_building(void) {
+    Building b;
+    unsigned char* via;
+    long long* frontier;
+    long long* next;
+    size_t frontier_cap = 1024, next_cap = 1024, frontier_len = 0;
+    long long explored = 1, total, per_floor;
+    long long offset[6];
+    int found = 0, out_of_memory = 0;
+
+    char path[260];
+    set_color(CYAN);
+    printf("Building file (Enter for %s): ", filename);
+    set_color(WHITE);
+    read_line(path, sizeof(path));
+    if (path[0] == '\0') strcpy(path, filename);
+
+    if (!open_building(path, &b)) {
+        wait_for_enter();
+        return;
+    }
+    if (b.start == -1 || b.exit == -1) {
+        set_color(RED);
+        printf("The building must contain 'S' and 'E'!\n");
+        set_color(WHITE);
+        free(b.floor_offset);
+        unmap_file(b.data, b.size);
+        wait_for_enter();
+        return;
+    }
+
+    per_floor = (long long)b.rows * b.cols;
+    total = per_floor * b.floors;
+    offset[0] = -b.cols;
+    offset[1] = b.cols;
+    offset[2] = -1;
+    offset[3] = 1;
+    offset[4] = per_floor;
+    offset[5] = -per_floor;
+
+    via = (unsigned long long)total / 2 + 1 <= (size_t)-1
+        ? (unsigned char*)calloc((size_t)(total / 2 + 1), 1) : NULL;
+    frontier = (long long*)malloc(frontier_cap * sizeof(long long));
+    next = (long long*)malloc(next_cap * sizeof(long long));
+    if (via == NULL || frontier == NULL || next == NULL) {
+        set_color(RED);
+        printf("Not enough memory to search %d floor(s) of %dx%d!\n", b.floors, b.rows, b.cols);
+        set_color(WHITE);
+        free(via);
+        free(frontier);
+        free(next);
+        free(b.floor_offset);
+        unmap_file(b.data, b.size);
+        wait_for_enter();
+        return;
+    }
+    via[b.start >> 1] |= (unsigned char)(7 << ((b.start & 1) * 4));
+    frontier[frontier_len++] = b.start;
+
+    while (frontier_len > 0 && !found && !out_of_memory) {
+        size_t next_len = 0, i;
+        for (i = 0; i < frontier_len && !found && !out_of_memory; i++) {
+            long long x = frontier[i];
+            int z = (int)(x / per_floor);
+            int r = (int)(x % per_floor / b.cols);
+            int c = (int)(x % b.cols);
+            char here = building_cell(&b, x);
+
+            int d;
+            for (d = 0; d < 6; d++) {
+                if (d == 0 && r == 0) continue;
+                if (d == 1 && r == b.rows - 1) continue;
+                if (d == 2 && c == 0) continue;
+                if (d == 3 && c == b.cols - 1) continue;
+                if (d == 4 && (here != '<' || z == b.floors - 1)) continue;
+                if (d == 5 && (here != '>' || z == 0)) continue;
+
+                long long y = x + offset[d];
+                if (building_via(via, y) || building_cell(&b, y) == '#') continue;
+                if (next_len == next_cap && !grow_frontier(&next, &next_cap)) {
+                    out_of_memory = 1;
+                    break;
+                }
+                via[y >> 1] |= (unsigned char)((d + 1) << ((y & 1) * 4));
+                next[next_len++] = y;
+                explored++;
+                if (y == b.exit) {
+                    found = 1;
+                    break;
+                }
+            }
+        }
+
+        long long* swap = frontier;
+        size_t swap_cap = frontier_cap;
+        frontier = next;
+        frontier_cap = next_cap;
+        frontier_len = next_len;
+        next = swap;
+        next_cap = swap_cap;
+    }
+
+    if (out_of_memory) {
+        set_color(RED);
+        printf("Not enough memory for the search frontier after %lld cells!\n", explored);
+        set_color(WHITE);
+    }
+    else if (!found) {
+        set_color(RED);
+        printf("No path exists through the building!\n");
+        set_color(WHITE);
+    }
+    else {
+        long long x;
+        int length = 0, floor_changes = 0, move;
+        for (x = b.exit; (move = building_via(via, x)) != 7; x -= offset[move - 1]) {
+            length++;
+            if (move >= 5) floor_changes++;
+        }
+
+        // Draw every floor the path visits, unless there are too many to page through.
+        if (b.rows <= MAXR && b.cols < MAXC && floor_changes < MAX_FLOORS_SHOWN) {
+            int z, i;
+            for (z = 0; z < b.floors; z++) {
+                char view[MAXR][MAXC];
+                int on_path = 0;
+                for (i = 0; i < b.rows; i++) {
+                    memcpy(view[i], b.data + b.floor_offset[z] + (size_t)i * b.stride, b.cols);
+                    view[i][b.cols] = '\0';
+                }
+                for (x = b.exit; ; x -= offset[move - 1]) {
+                    if (x / per_floor == z) {
+                        int r = (int)(x % per_floor / b.cols), c = (int)(x % b.cols);
+                        if (view[r][c] == '*' || view[r][c] == ' ') view[r][c] = 'b';
+                        on_path = 1;
+                    }
+                    if ((move = building_via(via, x)) == 7) break;
+                }
+                if (!on_path) continue;
+
+                int saved_rows = rows, saved_cols = cols;
+                rows = b.rows;
+                cols = b.cols;
+                print_maze(view, 0);
+                rows = saved_rows;
+                cols = saved_cols;
+                set_color(YELLOW);
+                printf("Floor %d of %d\n", z + 1, b.floors);
+                set_color(WHITE);
+                wait_for_enter();
+            }
+        }
+        set_color(YELLOW);
+        printf("Shortest path through %d floor(s) of %dx%d: %d steps, %d stair move(s), %lld cells explored.\n",
+            b.floors, b.rows, b.cols, length, floor_changes, explored);
+        set_color(WHITE);
+    }
+
+    free(via);
+    free(frontier);
+    free(next);
+    free(b.floor_offset);
+    unmap_file(b.data, b.size);
+    wait_for_enter();
+}
+
+/** @} */
+
+/**
+ * @defgroup TimedGates Periodic Gates (Space-Time BFS)
+ * @{
+ */
+
+ /**
+  * @brief Greatest common divisor of two positive integers.
+  */
+int gcd(int a, int b) {
+    while (b != 0) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+/**
+ * @brief Tells whether a cell can be occupied at tick t (walls never, gates on schedule).
+ */
+int open_at(int r, int c, int t) {
+    unsigned char ch = (unsigned char)maze[r][c];
+    if (ch == '#') return 0;
+    if (gate_period[ch] == 0) return 1;
+    return t % gate_period[ch] < gate_open[ch];
+}
+
+/**
+ * @brief Earliest arrival at 'E' when gates open and close periodically.
+ * @details BFS over (cell, t mod L) states, where L is the LCM of all gate periods,
+ *          so the schedule repeats every L ticks. Each tick the walker moves to a
+ *          neighbour or waits; the cell it ends up in must be open at the new tick.
+ *          Visited states are one bit per (cell, phase), and the queue grows on demand
+ *          and keeps each state's parent to draw the route.
+ */
+void timed_gates(void) {
+    unsigned char* seen;
+    int* queue;
+    int* parent;
+    size_t qcap = 1024, head = 0, tail = 0;
+    long goal = -1;
+    int period = 1, gates = 0, out_of_memory = 0;
+    int ch;
+
+    for (ch = 0; ch < 256; ch++) {
+        if (gate_period[ch] == 0) continue;
+        gates++;
+        period = period / gcd(period, gate_period[ch]) * gate_period[ch];
+        if (period > MAX_TIME_PERIOD) {
+            set_color(RED);
+            printf("The gate periods repeat only every %d+ ticks (at most %d supported)!\n", period, MAX_TIME_PERIOD);
+            set_color(WHITE);
+            wait_for_enter();
+            return;
+        }
+    }
+
+    size_t bytes_per_cell = (size_t)(period + 7) / 8;
+    seen = (unsigned char*)calloc((size_t)rows * cols * bytes_per_cell, 1);
+    queue = (int*)malloc(qcap * sizeof(int));
+    parent = (int*)malloc(qcap * sizeof(int));
+    if (seen == NULL || queue == NULL || parent == NULL) {
+        set_color(RED);
+        printf("Not enough memory for the gate search!\n");
+        set_color(WHITE);
+        free(seen);
+        free(queue);
+        free(parent);
+        wait_for_enter();
+        return;
+    }
+
+    // A state is (r * cols + c) * period + phase; tick 0 is spent at 'S'.
+    queue[tail] = (sr * cols + sc) * period;
+    parent[tail] = -1;
+    seen[(size_t)(sr * cols + sc) * bytes_per_cell] |= 1;
+    tail++;
+
+    while (head < tail && !out_of_memory) {
+        int cell = queue[head] / period, phase = queue[head] % period;
+        int cr = cell / cols, cc = cell % cols;
+        int t = (phase + 1) % period;
+
+        if (cr == er && cc == ec) {
+            goal = (long)head;
+            break;
+        }
+
+        int d;
+        for (d = -1; d < NUM_MOVES; d++) {
+            int nr = cr, nc = cc;
+            if (d >= 0 && !neighbor_cell(cr, cc, d, &nr, &nc)) continue;
+            if (!open_at(nr, nc, t)) continue;
+
+            int ncell = nr * cols + nc;
+            unsigned char* bits = &seen[(size_t)ncell * bytes_per_cell + t / 8];
+            if (*bits & (1 << (t % 8))) continue;
+            *bits |= (unsigned char)(1 << (t % 8));
+
+            if (tail == qcap) {
+                int* grown_queue = (int*)realloc(queue, qcap * 2 * sizeof(int));
+                if (grown_queue != NULL) queue = grown_queue;
+                int* grown_parent = grown_queue ? (int*)realloc(parent, qcap * 2 * sizeof(int)) : NULL;
+                if (grown_parent == NULL) {
+                    out_of_memory = 1;
+                    break;
+                }
+                parent = grown_parent;
+                qcap *= 2;
+            }
+            queue[tail] = ncell * period + t;
+            parent[tail] = (int)head;
+            tail++;
+        }
+        head++;
+    }
+
+    if (out_of_memory) {
+        set_color(RED);
+        printf("Not enough memory for the gate search after %lu states!\n", (unsigned long)tail);
+        set_color(WHITE);
+    }
+    else if (goal == -1) {
+        set_color(RED);
+        printf("No path exists, whatever the timing!\n");
+        set_color(WHITE);
+    }
+    else {
+        int ticks = 0, waits = 0;
+        long x;
+        for (x = goal; parent[x] != -1; x = parent[x]) {
+            int cell = queue[x] / period;
+            char* cp = &maze[cell / cols][cell % cols];
+            if (queue[parent[x]] / period == cell) waits++;
+            if (*cp == '*' || *cp == ' ' || (*cp >= '0' && *cp <= '9')) *cp = 'b';
+            ticks++;
+        }
+        print_maze(maze, 0);
+        set_color(YELLOW);
+        printf("Earliest arrival at E: tick %d (%d move(s), %d wait(s)); %d gate type(s), schedule repeats every %d ticks.\n",
+            ticks, ticks - waits, waits, gates, period);
+        set_color(WHITE);
+    }
+    printf("States explored: %lu, visited bitset %lu KB\n", (unsigned long)tail,
+        (unsigned long)((size_t)rows * cols * bytes_per_cell / 1024));
+
+    free(seen);
+    free(queue);
+    free(parent);
+    wait_for_enter();
+}
+
+/** @} */
+
+/**
+ * @defgroup Editing Wall Editing & Incremental Path Repair (LPA*)
+ * @{
+ */
+
+/**
+ * @brief Indexed binary min-heap of cells ordered by two-part LPA* / D* Lite keys.
+ * @details pos allows a queued cell to be found and removed when its key changes.
+ */
+typedef struct {
+    int k1[QSIZE], k2[QSIZE];   /**< Priority keys of each entry */
+    int cell[QSIZE];            /**< Cell index of each entry */
+    int n;                      /**< Number of entries */
+    int pos[MAXR][MAXC];        /**< Position of each cell in the heap (-1 if not queued) */
+} KeyHeap;
+
+KeyHeap lpa_heap;                   /**< Queue of inconsistent cells for the wall editor */
+
+ /**
+  * @brief Tells whether key (a1, a2) comes before key (b1, b2).
+  */
+int key_less(int a1, int a2, int b1, int b2) {
+    return a1 < b1 || (a1 == b1 && a2 < b2);
+}
+
+/**
+ * @brief Swaps two heap entries and keeps pos in sync.
+ */
+void keyheap_swap(KeyHeap* h, int a, int b) {
+    int t;
+    t = h->k1[a]; h->k1[a] = h->k1[b]; h->k1[b] = t;
+    t = h->k2[a]; h->k2[a] = h->k2[b]; h->k2[b] = t;
+    t = h->cell[a]; h->cell[a] = h->cell[b]; h->cell[b] = t;
+    h->pos[h->cell[a] / MAXC][h->cell[a] % MAXC] = a;
+    h->pos[h->cell[b] / MAXC][h->cell[b] % MAXC] = b;
+}
+
+/**
+ * @brief Restores the heap order around entry i after its key changed.
+ */
+void keyheap_fix(KeyHeap* h, int i) {
+    while (i > 0 && key_less(h->k1[i], h->k2[i], h->k1[(i - 1) / 2], h->k2[(i - 1) / 2])) {
+        keyheap_swap(h, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+    while (1) {
+        int best = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < h->n && key_less(h->k1[l], h->k2[l], h->k1[best], h->k2[best])) best = l;
+        if (r < h->n && key_less(h->k1[r], h->k2[r], h->k1[best], h->k2[best])) best = r;
+        if (best == i) break;
+        keyheap_swap(h, i, best);
+        i = best;
+    }
+}
+
+/**
+ * @brief Removes a cell from the heap if it is queued.
+ */
+void keyheap_remove(KeyHeap* h, int r, int c) {
+    int i = h->pos[r][c];
+    if (i == -1) return;
+    h->n--;
+    if (i != h->n) {
+        keyheap_swap(h, i, h->n);
+        keyheap_fix(h, i);
+    }
+    h->pos[r][c] = -1;
+}
+
+/**
+ * @brief Queues a cell that is not in the heap yet.
+ */
+void keyheap_insert(KeyHeap* h, int r, int c, int k1, int k2) {
+    int i = h->n++;
+    h->cell[i] = r * MAXC + c;
+    h->pos[r][c] = i;
+    h->k1[i] = k1;
+    h->k2[i] = k2;
+    keyheap_fix(h, i);
+}
+
+/**
+ * @brief Empties the heap for a rows x cols maze.
+ */
+void keyheap_clear(KeyHeap* h) {
+    int i, j;
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            h->pos[i][j] = -1;
+        }
+    }
+    h->n = 0;
+}
+
+/**
+ * @brief Computes the LPA* priority of a cell: [min(g, rhs) + h; min(g, rhs)].
+ */
+void lpa_key(int r, int c, int* k1, int* k2) {
+    int m = lpa_g[r][c] < lpa_rhs[r][c] ? lpa_g[r][c] : lpa_rhs[r][c];
+    *k1 = m == INT_MAX ? INT_MAX : m + astar_h(r, c);
+    *k2 = m;
+}
+
+/**
+ * @brief Recomputes rhs of a cell from its predecessors and (re)queues it if inconsistent.
+ */
+void lpa_update_vertex(int r, int c) {
+    if (r != sr || c != sc) {
+        int best = INT_MAX;
+        if (maze[r][c] != '#') {
+            int d;
+            for (d = 0; d < NUM_MOVES; d++) {
+                int nr, nc;
+                if (!prev_cell(r, c, d, &nr, &nc)) continue;
+                if (!is_valid(nr, nc) || lpa_g[nr][nc] == INT_MAX) continue;
+                if (lpa_g[nr][nc] + 1 < best) best = lpa_g[nr][nc] + 1;
+            }
+        }
+        lpa_rhs[r][c] = best;
+    }
+
+    keyheap_remove(&lpa_heap, r, c);
+    if (lpa_g[r][c] != lpa_rhs[r][c]) {
+        int k1, k2;
+        lpa_key(r, c, &k1, &k2);
+        keyheap_insert(&lpa_heap, r, c, k1, k2);
+    }
+}
+
+/**
+ * @brief Expands inconsistent cells until the distance of 'E' is settled.
+ * @details Only cells whose distance actually changed are touched, so the work after
+ *          an edit follows the size of the affected region, not the size of the maze.
+ */
+void lpa_compute(void) {
+    lpa_expanded = 0;
+    while (lpa_heap.n > 0) {
+        int gk1, gk2;
+        lpa_key(er, ec, &gk1, &gk2);
+        if (!key_less(lpa_heap.k1[0], lpa_heap.k2[0], gk1, gk2) && lpa_rhs[er][ec] == lpa_g[er][ec]) break;
+
+        int r = lpa_heap.cell[0] / MAXC, c = lpa_heap.cell[0] % MAXC;
+        keyheap_remove(&lpa_heap, r, c);
+        lpa_expanded++;
+
+        int overconsistent = lpa_g[r][c] > lpa_rhs[r][c];
+        lpa_g[r][c] = overconsistent ? lpa_rhs[r][c] : INT_MAX;
+        if (!overconsistent) lpa_update_vertex(r, c);
+
+        int d;
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!neighbor_cell(r, c, d, &nr, &nc)) continue;
+            if (nr == r && nc == c) continue;
+            lpa_update_vertex(nr, nc);
+        }
+    }
+}
+
+/**
+ * @brief Prepares LPA* for the loaded maze and computes the initial S-E distance.
+ */
+void lpa_init(void) {
+    int i, j;
+    compute_portal_bounds();
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            lpa_g[i][j] = INT_MAX;
+            lpa_rhs[i][j] = INT_MAX;
+        }
+    }
+    keyheap_clear(&lpa_heap);
+    lpa_rhs[sr][sc] = 0;
+    lpa_update_vertex(sr, sc);
+    lpa_compute();
+}
+
+/**
+ * @brief Flips a wall with flip_wall and repairs the LPA* distances incrementally.
+ * @details The cell and the cells its moves end on are re-evaluated; only cells whose distance
+ *          changes are expanded. If the connectivity forest shows that 'S' and 'E'
+ *          are disconnected, the search is skipped until an edit joins them again.
+ * @param r Row of the cell
+ * @param c Column of the cell
+ * @return 1 if the cell was toggled, 0 if it cannot be edited
+ */
+int toggle_wall(int r, int c) {
+    if (!flip_wall(r, c)) return 0;
+
+    lpa_update_vertex(r, c);
+    int d;
+    for (d = 0; d < NUM_MOVES; d++) {
+        int nr, nc;
+        if (neighbor_cell(r, c, d, &nr, &nc)) lpa_update_vertex(nr, nc);
+    }
+    // While S and E are cut apart the repair is deferred; the queued cells stay valid
+    lpa_expanded = 0;
+    if (conn_connected(sr, sc, er, ec)) lpa_compute();
+    return 1;
+}
+
+/**
+ * @brief Draws the current LPA* shortest path on a copy of the maze.
+ * @param view Receives the maze with the path marked 'b'
+ */
+void lpa_mark_path(char view[MAXR][MAXC]) {
+    int i, cr = er, cc = ec;
+    for (i = 0; i < rows; i++) strcpy(view[i], maze[i]);
+    if (!conn_connected(sr, sc, er, ec) || lpa_g[er][ec] == INT_MAX) return;
+
+    while (cr != sr || cc != sc) {
+        int br = -1, bc = -1, d;
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!prev_cell(cr, cc, d, &nr, &nc) || !is_valid(nr, nc)) continue;
+            if (lpa_g[nr][nc] == lpa_g[cr][cc] - 1) {
+                br = nr;
+                bc = nc;
+                break;
+            }
+        }
+        if (br == -1) return;
+        cr = br;
+        cc = bc;
+        if (view[cr][cc] != 'S') view[cr][cc] = 'b';
+    }
+}
+
+/**
+ * @brief Interactive wall editor that keeps the shortest path up to date with LPA*.
+ */
+void edit_walls(void) {
+    char view[MAXR][MAXC];
+    int r, c;
+
+    lpa_init();
+    while (1) {
+        lpa_mark_path(view);
+        print_maze(view, 0);
+        set_color(YELLOW);
+        if (!conn_connected(sr, sc, er, ec) || lpa_g[er][ec] == INT_MAX) printf("No path exists!");
+        else printf("Shortest path: %d steps", lpa_g[er][ec]);
+        printf(" (last repair expanded %d cells)\n", lpa_expanded);
+        set_color(CYAN);
+        printf("Toggle wall at row col (-1 to stop): ");
+        set_color(WHITE);
+        if (scanf("%d", &r) != 1 || r < 0) break;
+        if (scanf("%d", &c) != 1) break;
+
+        if (!toggle_wall(r, c)) {
+            set_color(RED);
+            printf("Only walls and plain open cells inside the maze can be toggled!\n");
+            set_color(WHITE);
+#ifdef _WIN32
+            Sleep(1000);
+#else
+            sleep(1);
+#endif
+        }
+    }
+    skip_line();
+}
+
+/** @} */
+
+/**
+ * @defgroup Explorer Exploring Unknown Mazes (D* Lite)
+ * @{
+ */
+
+ /**
+  * @brief State of one agent exploring a maze it cannot see.
+  * @details The agent knows the maze size, the exit and the portal links, and assumes
+  *          every cell it has not sensed yet is open. It senses only the cells one step
+  *          away. D* Lite searches from the exit back to the agent, so when a new wall
+  *          is found only the distances it invalidates are repaired. All state lives
+  *          here, so several agents can run on different threads.
+  */
+typedef struct {
+    const char (*truth)[MAXC];      /**< The real maze, only read through sensing */
+    int portals;                    /**< 1 if the loaded maze's portals apply (0 for generated mazes) */
+    int r, c;                       /**< Current position */
+    int goal_r, goal_c;             /**< Exit cell */
+    int last_r, last_c;             /**< Position at the previous replan */
+    int km;                         /**< Key modifier accumulated as the agent moves */
+    unsigned char wall[MAXR][MAXC]; /**< 1 for walls the agent has sensed */
+    unsigned char trail[MAXR][MAXC];/**< 1 for cells the agent has stood on */
+    int g[MAXR][MAXC];              /**< Distance estimate to the exit */
+    int rhs[MAXR][MAXC];            /**< One-step lookahead of g */
+    KeyHeap heap;                   /**< Inconsistent cells */
+    int steps;                      /**< Moves made so far */
+    int replans;                    /**< Searches caused by newly sensed walls */
+    int expanded;                   /**< Cells expanded over all searches */
+} Explorer;
+
+/**
+ * @brief Tells whether the explorer treats a cell as blocked (walls, and doors since it carries no keys).
+ */
+int explorer_blocked(const Explorer* e, int r, int c) {
+    char ch = e->truth[r][c];
+    return ch == '#' || is_door(ch);
+}
+
+/**
+ * @brief Cell where move d from (r, c) ends for this agent (neighbor_cell, or a plain step without portals).
+ */
+int explorer_move(const Explorer* e, int r, int c, int d, int* nr, int* nc) {
+    return e->portals ? neighbor_cell(r, c, d, nr, nc) : step_cell(r, c, d, nr, nc);
+}
+
+/**
+ * @brief Cell from which move d ends on (r, c) for this agent (the inverse of explorer_move).
+ */
+int explorer_back(const Explorer* e, int r, int c, int d, int* nr, int* nc) {
+    return e->portals ? prev_cell(r, c, d, nr, nc) : step_cell(r, c, d ^ 1, nr, nc);
+}
+
+/**
+ * @brief Heuristic distance between two cells (0 when portals make Manhattan inadmissible).
+ */
+int explorer_h(const Explorer* e, int r1, int c1, int r2, int c2) {
+    if (e->portals && num_portals > 0) return 0;
+    return manhattan(r1, c1, r2, c2);
+}
+
+/**
+ * @brief Computes the D* Lite priority of a cell: [min(g, rhs) + h + km; min(g, rhs)].
+ */
+void explorer_key(const Explorer* e, int r, int c, int* k1, int* k2) {
+    int m = e->g[r][c] < e->rhs[r][c] ? e->g[r][c] : e->rhs[r][c];
+    *k1 = m == INT_MAX ? INT_MAX : m + explorer_h(e, e->r, e->c, r, c) + e->km;
+    *k2 = m;
+}
+
+/**
+ * @brief Recomputes rhs of a cell from what the agent knows and (re)queues it if inconsistent.
+ */
+void explorer_update(Explorer* e, int r, int c) {
+    if (r != e->goal_r || c != e->goal_c) {
+        int best = INT_MAX;
+        if (!e->wall[r][c]) {
+            int d;
+            for (d = 0; d < NUM_MOVES; d++) {
+                int nr, nc;
+                if (!explorer_move(e, r, c, d, &nr, &nc)) continue;
+                if (e->wall[nr][nc] || e->g[nr][nc] == INT_MAX) continue;
+                if (e->g[nr][nc] + 1 < best) best = e->g[nr][nc] + 1;
+            }
+        }
+        e->rhs[r][c] = best;
+    }
+
+    keyheap_remove(&e->heap, r, c);
+    if (e->g[r][c] != e->rhs[r][c]) {
+        int k1, k2;
+        explorer_key(e, r, c, &k1, &k2);
+        keyheap_insert(&e->heap, r, c, k1, k2);
+    }
+}
+
+/**
+ * @brief Runs D* Lite until the agent's own cell has a settled distance to the exit.
+ */
+void explorer_compute(Explorer* e) {
+    KeyHeap* h = &e->heap;
+    while (h->n > 0) {
+        int sk1, sk2, k1, k2;
+        explorer_key(e, e->r, e->c, &sk1, &sk2);
+        if (!key_less(h->k1[0], h->k2[0], sk1, sk2) && e->rhs[e->r][e->c] == e->g[e->r][e->c]) break;
+
+        int r = h->cell[0] / MAXC, c = h->cell[0] % MAXC;
+        explorer_key(e, r, c, &k1, &k2);
+        if (key_less(h->k1[0], h->k2[0], k1, k2)) {
+            // Queued before the agent moved: the key is only outdated, not the distance
+            h->k1[0] = k1;
+            h->k2[0] = k2;
+            keyheap_fix(h, 0);
+            continue;
+        }
+
+        keyheap_remove(h, r, c);
+        e->expanded++;
+        int overconsistent = e->g[r][c] > e->rhs[r][c];
+        e->g[r][c] = overconsistent ? e->rhs[r][c] : INT_MAX;
+        if (!overconsistent) explorer_update(e, r, c);
+
+        int d;
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!explorer_back(e, r, c, d, &nr, &nc)) continue;
+            if (nr == r && nc == c) continue;
+            explorer_update(e, nr, nc);
+        }
+    }
+}
+
+/**
+ * @brief Senses the cells one step away and records newly found walls.
+ * @return 1 if a wall was found, in which case the affected cells have been re-queued
+ */
+int explorer_sense(Explorer* e) {
+    int found = 0, d;
+    for (d = 0; d < NUM_MOVES; d++) {
+        int nr, nc;
+        if (!step_cell(e->r, e->c, d, &nr, &nc)) continue;
+        if (e->wall[nr][nc] || !explorer_blocked(e, nr, nc)) continue;
+
+        if (!found) {
+            e->km += explorer_h(e, e->last_r, e->last_c, e->r, e->c);
+            e->last_r = e->r;
+            e->last_c = e->c;
+            found = 1;
+        }
+        e->wall[nr][nc] = 1;
+        explorer_update(e, nr, nc);
+
+        int d2;
+        for (d2 = 0; d2 < NUM_MOVES; d2++) {
+            int wr, wc;
+            if (explorer_back(e, nr, nc, d2, &wr, &wc)) explorer_update(e, wr, wc);
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Walks the agent from (start_r, start_c) towards the exit, replanning on every new wall.
+ * @param e Explorer whose truth, moves and goal are set
+ * @param start_r Row of the starting cell
+ * @param start_c Column of the starting cell
+ * @param max_steps Gives up after this many moves
+ * @return 1 if the exit was reached, 0 if it is unreachable or the step limit was hit. A
+ *         portal can lead into a dead end with no way back, so with portals the agent
+ *         may also get stuck where a full map would have avoided the trap.
+ */
+int explorer_run(Explorer* e, int start_r, int start_c, int max_steps) {
+    int i, j;
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            e->g[i][j] = INT_MAX;
+            e->rhs[i][j] = INT_MAX;
+            e->wall[i][j] = 0;
+            e->trail[i][j] = 0;
+        }
+    }
+    keyheap_clear(&e->heap);
+    e->r = e->last_r = start_r;
+    e->c = e->last_c = start_c;
+    e->km = 0;
+    e->steps = e->replans = e->expanded = 0;
+    e->trail[start_r][start_c] = 1;
+
+    e->rhs[e->goal_r][e->goal_c] = 0;
+    explorer_update(e, e->goal_r, e->goal_c);
+    explorer_sense(e);
+    explorer_compute(e);
+
+    while (e->r != e->goal_r || e->c != e->goal_c) {
+        int br = -1, bc = -1, best = INT_MAX, d;
+        if (e->g[e->r][e->c] == INT_MAX || e->steps >= max_steps) return 0;
+
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!explorer_move(e, e->r, e->c, d, &nr, &nc) || e->wall[nr][nc]) continue;
+            if (e->g[nr][nc] != INT_MAX && e->g[nr][nc] < best) {
+                best = e->g[nr][nc];
+                br = nr;
+                bc = nc;
+            }
+        }
+        if (br == -1) return 0;
+
+        e->r = br;
+        e->c = bc;
+        e->steps++;
+        e->trail[br][bc] = 1;
+        if (explorer_sense(e)) {
+            e->replans++;
+            explorer_compute(e);
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Length of the true shortest path from the start to the exit (-1 if none).
+ * @details Reuses the explorer's g array and heap storage as BFS scratch, so it must
+ *          be called before explorer_run.
+ */
+int explorer_optimal(Explorer* e, int start_r, int start_c) {
+    int head = 0, tail = 0, i, j;
+    int* queue = e->heap.cell;
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) {
+            e->g[i][j] = -1;
+        }
+    }
+    e->g[start_r][start_c] = 0;
+    queue[tail++] = start_r * MAXC + start_c;
+    while (head < tail) {
+        int cr = queue[head] / MAXC, cc = queue[head] % MAXC, d;
+        head++;
+        if (cr == e->goal_r && cc == e->goal_c) return e->g[cr][cc];
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!explorer_move(e, cr, cc, d, &nr, &nc)) continue;
+            if (explorer_blocked(e, nr, nc) || e->g[nr][nc] != -1) continue;
+            e->g[nr][nc] = e->g[cr][cc] + 1;
+            queue[tail++] = nr * MAXC + nc;
+        }
+    }
+    return -1;
+}
+
+/**
+ * @brief Small seeded random generator, so every thread has its own reproducible stream.
+ */
+unsigned int xorshift32(unsigned int* state) {
+    unsigned int x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+/**
+ * @brief Generates a rows x cols maze from a seed: a random spanning tree with some loops.
+ * @details Passages are carved on odd coordinates by a randomized DFS, then one in
+ *          LOOP_OPENING_ODDS of the walls between two passages is opened, so dead ends
+ *          and detours both occur. 'S' is at (1, 1) and 'E' at the opposite corner.
+ * @param grid Receives the maze
+ * @param seed Seed of the maze
+ * @param stack Scratch array of at least QSIZE entries
+ */
+void generate_maze(char grid[MAXR][MAXC], unsigned int seed, int* stack) {
+    unsigned int state = seed * 2654435761u + 1;
+    int hr = (rows - 1) / 2, hc = (cols - 1) / 2;   // passage cells per column / row
+    int top = 0, i, j;
+
+    for (i = 0; i < rows; i++) {
+        for (j = 0; j < cols; j++) grid[i][j] = '#';
+        grid[i][cols] = '\0';
+    }
+
+    grid[1][1] = '*';
+    stack[top++] = 0;
+    while (top > 0) {
+        int cell = stack[top - 1];
+        int cr = cell / hc, cc = cell % hc;
+        int options[4], n = 0, d;
+        for (d = 0; d < 4; d++) {
+            int nr = cr + dr[d], nc = cc + dc[d];
+            if (nr < 0 || nr >= hr || nc < 0 || nc >= hc) continue;
+            if (grid[2 * nr + 1][2 * nc + 1] == '#') options[n++] = d;
+        }
+        if (n == 0) {
+            top--;
+            continue;
+        }
+        d = options[xorshift32(&state) % n];
+        grid[2 * cr + 1 + dr[d]][2 * cc + 1 + dc[d]] = '*';
+        grid[2 * (cr + dr[d]) + 1][2 * (cc + dc[d]) + 1] = '*';
+        stack[top++] = (cr + dr[d]) * hc + cc + dc[d];
+    }
+
+    for (i = 1; i < rows - 1; i++) {
+        for (j = 1; j < cols - 1; j++) {
+            if (grid[i][j] != '#' || (i % 2) == (j % 2)) continue;  // only walls between two passages
+            if (i % 2 == 0 && i + 1 >= 2 * hr + 1) continue;
+            if (j % 2 == 0 && j + 1 >= 2 * hc + 1) continue;
+            if (xorshift32(&state) % LOOP_OPENING_ODDS == 0) grid[i][j] = '*';
+        }
+    }
+
+    grid[1][1] = 'S';
+    grid[2 * hr - 1][2 * hc - 1] = 'E';
+}
+
+/**
+ * @brief Work item of the exploration benchmark: a contiguous range of seeds.
+ */
+typedef struct {
+    unsigned int first_seed;    /**< Seed of the first trial */
+    int count;                  /**< Number of trials */
+    int* steps;                 /**< Receives the steps of each trial (-1 if the exit was not reached) */
+    int* replans;               /**< Receives the replans of each trial */
+    int* optimal;               /**< Receives the true shortest path length of each trial */
+} ExploreJob;
+
+/**
+ * @brief Thread body running the trials of an ExploreJob.
+ */
+THREAD_FUNC(explore_job_worker) {
+    ExploreJob* job = (ExploreJob*)arg;
+    Explorer* e = (Explorer*)malloc(sizeof(Explorer));
+    char (*grid)[MAXC] = (char(*)[MAXC])malloc(sizeof(char) * MAXR * MAXC);
+    int* stack = (int*)malloc(sizeof(int) * QSIZE);
+    int t;
+
+    if (!e || !grid || !stack) {
+        for (t = 0; t < job->count; t++) job->steps[t] = -1;
+        free(e);
+        free(grid);
+        free(stack);
+        THREAD_RETURN;
+    }
+
+    for (t = 0; t < job->count; t++) {
+        generate_maze(grid, job->first_seed + t, stack);
+        e->truth = (const char(*)[MAXC])grid;
+        e->portals = 0;
+        e->goal_r = 2 * ((rows - 1) / 2) - 1;
+        e->goal_c = 2 * ((cols - 1) / 2) - 1;
+        job->optimal[t] = explorer_optimal(e, 1, 1);
+        job->steps[t] = explorer_run(e, 1, 1, rows * cols * 4) ? e->steps : -1;
+        job->replans[t] = e->replans;
+    }
+
+    free(e);
+    free(grid);
+    free(stack);
+    THREAD_RETURN;
+}
+
+/**
+ * @brief qsort comparator for ints in ascending order.
+ */
+int compare_ints(const void* a, const void* b) {
+    int x = *(const int*)a, y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Runs seeded exploration trials on all processors and prints the steps-to-exit distribution.
+ * @param trials Number of generated mazes (each the size of the loaded maze)
+ */
+void explore_benchmark(int trials) {
+    ExploreJob jobs[MAX_THREADS];
+    int* steps = (int*)malloc(sizeof(int) * trials);
+    int* replans = (int*)malloc(sizeof(int) * trials);
+    int* optimal = (int*)malloc(sizeof(int) * trials);
+    int n = cpu_count(), i, done = 0, failed = 0;
+    double ratio = 0, mean_replans = 0;
+
+    if (!steps || !replans || !optimal) {
+        set_color(RED);
+        printf("Not enough memory for %d trials!\n", trials);
+        set_color(WHITE);
+        free(steps);
+        free(replans);
+        free(optimal);
+        return;
+    }
+
+    if (n > MAX_THREADS) n = MAX_THREADS;
+    if (n > trials) n = trials;
+    for (i = 0; i < n; i++) {
+        int first = (int)((long long)trials * i / n), last = (int)((long long)trials * (i + 1) / n);
+        jobs[i].first_seed = (unsigned int)first + 1;
+        jobs[i].count = last - first;
+        jobs[i].steps = steps + first;
+        jobs[i].replans = replans + first;
+        jobs[i].optimal = optimal + first;
+    }
+    run_workers(explore_job_worker, jobs, sizeof(ExploreJob), n);
+
+    for (i = 0; i < trials; i++) {
+        if (steps[i] == -1) {
+            failed++;
+            continue;
+        }
+        if (optimal[i] > 0) ratio += (double)steps[i] / optimal[i];
+        mean_replans += replans[i];
+        steps[done++] = steps[i];
+    }
+
+    set_color(YELLOW);
+    printf("\n%d trials on %dx%d generated mazes (%d thread%s):\n", trials, rows, cols, n, n == 1 ? "" : "s");
+    set_color(WHITE);
+    if (done == 0) {
+        set_color(RED);
+        printf("No trial reached the exit!\n");
+        set_color(WHITE);
+    }
+    else {
+        qsort(steps, done, sizeof(int), compare_ints);
+        printf("Steps to exit: min %d, median %d, p90 %d, p99 %d, max %d\n",
+            steps[0], steps[done / 2], steps[(long long)done * 9 / 10], steps[(long long)done * 99 / 100], steps[done - 1]);
+        printf("Mean steps / shortest path: %.2f, mean replans: %.1f\n", ratio / done, mean_replans / done);
+
+        int lo = steps[0], span = steps[done - 1] - lo + 1, b, k = 0;
+        int width = (span + 9) / 10, peak = 1, count[10] = { 0 };
+        for (i = 0; i < done; i++) count[(steps[i] - lo) / width]++;
+        for (b = 0; b < 10; b++) if (count[b] > peak) peak = count[b];
+        for (b = 0; b < 10 && k < done; b++) {
+            printf("%6d-%-6d %6d ", lo + b * width, lo + (b + 1) * width - 1, count[b]);
+            set_color(GREEN);
+            for (i = 0; i < count[b] * 40 / peak; i++) printf("*");
+            set_color(WHITE);
+            printf("\n");
+            k += count[b];
+        }
+    }
+    if (failed > 0) {
+        set_color(RED);
+        printf("%d trial(s) did not reach the exit.\n", failed);
+        set_color(WHITE);
+    }
+
+    free(steps);
+    free(replans);
+    free(optimal);
+}
+
+/**
+ * @brief Lets an agent that only senses adjacent cells find its way from 'S' to 'E',
+ *        then optionally benchmarks the agent on seeded random mazes.
+ */
+void explore_unknown(void) {
+    Explorer* e = (Explorer*)malloc(sizeof(Explorer));
+    char view[MAXR][MAXC];
+    int i, j, trials = 0;
+
+    if (!e) {
+        set_color(RED);
+        printf("Not enough memory for the explorer!\n");
+        set_color(WHITE);
+        return;
+    }
+
+    e->truth = (const char(*)[MAXC])maze;
+    e->portals = 1;
+    e->goal_r = er;
+    e->goal_c = ec;
+    int optimal = explorer_optimal(e, sr, sc);
+    int reached = explorer_run(e, sr, sc, rows * cols * 4);
+
+    // Walls the agent never sensed stay hidden
+    for (i = 0; i < rows; i++) {
+        strcpy(view[i], maze[i]);
+        for (j = 0; j < cols; j++) {
+            if (explorer_blocked(e, i, j) && !e->wall[i][j]) view[i][j] = '.';
+            else if (e->trail[i][j] && view[i][j] != 'S' && view[i][j] != 'E') view[i][j] = 'b';
+        }
+    }
+    print_maze(view, 0);
+
+    set_color(reached ? GREEN : RED);
+    if (reached) printf("The explorer reached the exit in %d steps", e->steps);
+    else printf("The explorer could not reach the exit (gave up after %d steps)", e->steps);
+    set_color(WHITE);
+    printf(" - %d replans, %d cells expanded", e->replans, e->expanded);
+    if (optimal != -1) printf(", shortest path %d", optimal);
+    printf(".\nUnsensed walls are shown as '.'.\n");
+    free(e);
+
+    if (rows < 5 || cols < 5) return;
+    set_color(CYAN);
+    printf("\nBenchmark: number of seeded random mazes to explore (0 to skip, at most %d): ", MAX_EXPLORE_TRIALS);
+    set_color(WHITE);
+    scanf("%d", &trials);
+    skip_line();
+    if (trials <= 0) return;
+    if (trials > MAX_EXPLORE_TRIALS) trials = MAX_EXPLORE_TRIALS;
+    explore_benchmark(trials);
+    wait_for_enter();
+}
+
+/** @} */
+
+/**
+ * @defgroup LowMemory Memory-Frugal Solvers
+ * @{
+ */
+
+ /**
+  * @brief Outcome of one memory-frugal solver.
+  */
+typedef struct {
+    const char* name;           /**< Engine name */
+    int found;                  /**< 1 if 'E' was reached */
+    long moves;                 /**< Moves walked (followers, Tremaux) or cells expanded (IDA*) */
+    int length;                 /**< Length of the reported route (-1 if none) */
+    size_t bytes;               /**< Working memory used besides the maze itself */
+    double bits_per_cell;       /**< Bits of working memory per maze cell (0 for constant memory) */
+} FrugalResult;
+
+/**
+ * @brief Directions after turning right (clockwise) from each of up, down, left, right.
+ */
+int turn_right[4] = { 3, 2, 0, 1 };
+
+/**
+ * @brief Directions after turning left (counterclockwise) from each of up, down, left, right.
+ */
+int turn_left[4] = { 2, 3, 1, 0 };
+
+/**
+ * @brief Tells whether move d from (r, c) leads to an open cell.
+ */
+int can_step(int r, int c, int d, int* nr, int* nc) {
+    return neighbor_cell(r, c, d, nr, nc) && is_valid(*nr, *nc);
+}
+
+/**
+ * @brief One right-hand-rule step: tries right, straight, left, then back.
+ * @param r Row, updated to the new position
+ * @param c Column, updated to the new position
+ * @param h Heading, updated to the new heading
+ * @return Net quarter turns made (+1 per right turn, -1 per left turn), or 99 if boxed in
+ */
+int follow_step(int* r, int* c, int* h) {
+    int tries[4] = { turn_right[*h], *h, turn_left[*h], turn_left[turn_left[*h]] };
+    int turns[4] = { 1, 0, -1, -2 };
+    int i, nr, nc;
+    for (i = 0; i < 4; i++) {
+        if (can_step(*r, *c, tries[i], &nr, &nc)) {
+            *r = nr;
+            *c = nc;
+            *h = tries[i];
+            return turns[i];
+        }
+    }
+    return 99;
+}
+
+/**
+ * @brief Wall follower: keeps a hand on the right-hand wall from 'S' until 'E'.
+ * @details Needs only a position and a heading. It walks up to a wall and then
+ *          follows it, reaching 'E' whenever 'E' lies along that wall, which is always
+ *          the case in a simply connected maze. It gives up once it has walked all
+ *          the way around the wall.
+ */
+FrugalResult wall_follower(void) {
+    FrugalResult res = { "Wall follower", 0, 0, -1, 6 * sizeof(int), 0 };
+    int r = sr, c = sc, h = 0, r1, c1, h1;
+    long limit = 4L * rows * cols + 4;
+
+    // Walk straight up to the first wall, then keep it on the right-hand side
+    while (can_step(r, c, h, &r1, &c1) && (r != er || c != ec) && res.moves <= limit) {
+        r = r1;
+        c = c1;
+        res.moves++;
+    }
+    h = turn_left[h];
+    if (res.moves > limit) return res;
+
+    // The walk is periodic, so seeing the state after the first move again means a full loop
+    if (r != er || c != ec) {
+        if (follow_step(&r, &c, &h) == 99) return res;
+        res.moves++;
+    }
+    r1 = r;
+    c1 = c;
+    h1 = h;
+    while (r != er || c != ec) {
+        follow_step(&r, &c, &h);
+        res.moves++;
+        if ((r == r1 && c == c1 && h == h1) || res.moves > limit) return res;
+    }
+    res.found = 1;
+    res.length = (int)res.moves;
+    return res;
+}
+
+/**
+ * @brief Pledge algorithm: heads towards 'E' and wall-follows around obstacles.
+ * @details The preferred heading points along the longer axis towards 'E'. On hitting
+ *          a wall the walker follows it with its right hand, counting quarter turns,
+ *          and leaves only when the count is back to zero. This escapes any obstacle,
+ *          so it finds exits on the outer border; an interior 'E' may be missed.
+ */
+FrugalResult pledge(void) {
+    FrugalResult res = { "Pledge", 0, 0, -1, 5 * sizeof(int), 0 };
+    int r = sr, c = sc, h, turns = 0, nr, nc;
+    long limit = 8L * rows * cols + 8;
+    int pref = abs(er - sr) >= abs(ec - sc) ? (er > sr ? 1 : 0) : (ec > sc ? 3 : 2);
+
+    h = pref;
+    while (r != er || c != ec) {
+        if (res.moves++ > limit) return res;
+        if (turns == 0 && can_step(r, c, pref, &nr, &nc)) {
+            r = nr;
+            c = nc;
+            h = pref;
+            continue;
+        }
+        if (turns == 0) {
+            // Hit a wall: turn left so that it is on the right-hand side
+            h = turn_left[pref];
+            turns = -1;
+            if (can_step(r, c, h, &nr, &nc)) {
+                r = nr;
+                c = nc;
+                continue;
+            }
+        }
+        int t = follow_step(&r, &c, &h);
+        if (t == 99) return res;
+        turns += t;
+    }
+    res.found = 1;
+    res.length = (int)res.moves;
+    return res;
+}
+
+/**
+ * @brief Reads the 2-bit mark of cell i from a packed array.
+ */
+int get_mark(const unsigned char* marks, long i) {
+    return (marks[i >> 2] >> ((i & 3) * 2)) & 3;
+}
+
+/**
+ * @brief Writes the 2-bit mark of cell i in a packed array.
+ */
+void set_mark(unsigned char* marks, long i, int v) {
+    marks[i >> 2] = (unsigned char)((marks[i >> 2] & ~(3 << ((i & 3) * 2))) | (v << ((i & 3) * 2)));
+}
+
+/**
+ * @brief Tells whether cell (r, c) can be entered from (fr, fc) without touching the rest of the route.
+ * @details Only cells with a move onto (r, c) count, since those are the ones a step back could take.
+ */
+int tremaux_free(const unsigned char* marks, int r, int c, int fr, int fc) {
+    int d, nr, nc;
+    for (d = 0; d < NUM_MOVES; d++) {
+        if (!prev_cell(r, c, d, &nr, &nc)) continue;
+        if ((nr != fr || nc != fc) && get_mark(marks, (long)nr * cols + nc) == 1) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Tremaux's method with 2 bits per cell: unvisited, on the route, or dead end.
+ * @details The walker enters an unvisited cell only if it touches no other route
+ *          cell, so the route never touches itself and the way back from a dead end
+ *          is always the one route cell with a move onto it. A skipped cell becomes
+ *          enterable once its other route neighbours are marked dead, so every
+ *          reachable cell is tried. The cells left on the route form the path to 'E'.
+ * @param view Receives the maze with the route marked 'b'
+ */
+FrugalResult tremaux(char view[MAXR][MAXC]) {
+    FrugalResult res = { "Tremaux (2 bits/cell)", 0, 0, -1, 0, 0 };
+    size_t size = ((size_t)rows * cols + 3) / 4;
+    unsigned char* marks = (unsigned char*)calloc(size, 1);
+    int r = sr, c = sc, d, nr, nc, i, j;
+
+    if (!marks) return res;
+    res.bytes = size;
+    res.bits_per_cell = 8.0 * size / ((double)rows * cols);
+
+    set_mark(marks, (long)r * cols + c, 1);
+    while (r != er || c != ec) {
+        for (d = 0; d < NUM_MOVES; d++) {
+            if (!can_step(r, c, d, &nr, &nc) || get_mark(marks, (long)nr * cols + nc) != 0) continue;
+            if (tremaux_free(marks, nr, nc, r, c)) break;
+        }
+        if (d == NUM_MOVES) {
+            // Dead end: mark it and step back along the route
+            set_mark(marks, (long)r * cols + c, 2);
+            if (r == sr && c == sc) break;
+            for (d = 0; d < NUM_MOVES; d++) {
+                if (prev_cell(r, c, d, &nr, &nc) && get_mark(marks, (long)nr * cols + nc) == 1) break;
+            }
+        }
+        else {
+            set_mark(marks, (long)nr * cols + nc, 1);
+        }
+        r = nr;
+        c = nc;
+        res.moves++;
+    }
+
+    if (r == er && c == ec) {
+        res.found = 1;
+        res.length = -1;
+        for (i = 0; i < rows; i++) {
+            for (j = 0; j < cols; j++) {
+                if (get_mark(marks, (long)i * cols + j) != 1) continue;
+                res.length++;
+                if (view[i][j] != 'S' && view[i][j] != 'E') view[i][j] = 'b';
+            }
+        }
+    }
+    free(marks);
+    return res;
+}
+
+/**
+ * @brief Iterative-deepening A* with a bitset of the cells on the current route.
+ * @details Each iteration is a depth-first search bounded by g + h; the next bound is
+ *          the smallest value that exceeded it. The stack keeps one byte per level
+ *          (the next move to try there), and the position is restored on backtrack
+ *          by undoing the move with prev_cell, so memory is one bit per cell plus the path length.
+ *          Repeated paths are not detected, so it gives up after MAX_IDA_EXPANSIONS.
+ */
+FrugalResult ida_bitset(void) {
+    FrugalResult res = { "IDA* (bitset)", 0, 0, -1, 0, 0 };
+    size_t bits = ((size_t)rows * cols + 7) / 8;
+    unsigned char* on_path = (unsigned char*)calloc(bits, 1);
+    unsigned char* next_move = NULL;
+    int cap = 0, limit;
+
+    if (!on_path) return res;
+    compute_portal_bounds();
+    limit = astar_h(sr, sc);
+
+    while (res.moves < MAX_IDA_EXPANSIONS) {
+        int next_limit = INT_MAX, depth = 0, r = sr, c = sc;
+        if (limit + 1 > cap) {
+            unsigned char* grown = (unsigned char*)realloc(next_move, limit + 1);
+            if (!grown) break;
+            next_move = grown;
+            cap = limit + 1;
+        }
+        on_path[((long)sr * cols + sc) >> 3] |= 1 << (((long)sr * cols + sc) & 7);
+        next_move[0] = 0;
+
+        while (depth >= 0) {
+            if (r == er && c == ec) {
+                res.found = 1;
+                res.length = depth;
+                break;
+            }
+            int d = next_move[depth]++, nr, nc;
+            if (d >= NUM_MOVES) {
+                long i = (long)r * cols + c;
+                on_path[i >> 3] &= ~(1 << (i & 7));
+                if (--depth >= 0) prev_cell(r, c, next_move[depth] - 1, &r, &c);
+                continue;
+            }
+            if (!can_step(r, c, d, &nr, &nc)) continue;
+            long i = (long)nr * cols + nc;
+            if (on_path[i >> 3] & (1 << (i & 7))) continue;
+            int f = depth + 1 + astar_h(nr, nc);
+            if (f > limit) {
+                if (f < next_limit) next_limit = f;
+                continue;
+            }
+            if (++res.moves >= MAX_IDA_EXPANSIONS) break;
+            on_path[i >> 3] |= 1 << (i & 7);
+            r = nr;
+            c = nc;
+            next_move[++depth] = 0;
+        }
+        if (res.found || next_limit == INT_MAX) break;
+        memset(on_path, 0, bits);
+        limit = next_limit;
+    }
+
+    res.bytes = bits + cap;
+    res.bits_per_cell = 8.0 * res.bytes / ((double)rows * cols);
+    free(on_path);
+    free(next_move);
+    return res;
+}
+
+/**
+ * @brief Physical memory currently available, in bytes (0 if unknown).
+ */
+unsigned long long available_memory(void) {
+#ifdef _WIN32
+    MEMORYSTATUSEX status;
+    status.dwLength = sizeof(status);
+    if (!GlobalMemoryStatusEx(&status)) return 0;
+    return status.ullAvailPhys;
+#elif defined(_SC_AVPHYS_PAGES)
+    long pages = sysconf(_SC_AVPHYS_PAGES), page = sysconf(_SC_PAGESIZE);
+    return pages > 0 && page > 0 ? (unsigned long long)pages * page : 0;
+#else
+    long pages = sysconf(_SC_PHYS_PAGES), page = sysconf(_SC_PAGESIZE);
+    return pages > 0 && page > 0 ? (unsigned long long)pages * page : 0;
+#endif
+}
+
+/**
+ * @brief Runs every memory-frugal solver and compares their memory with BFS.
+ * @details The route found by Tremaux's method is drawn. For each engine, the
+ *          largest maze (in cells) whose working memory fits in the available RAM
+ *          is printed as a guide for choosing an engine. The IDA* figure is memory
+ *          only: its time grows with the number of routes, so it is qualified, and
+ *          when it gave up on this maze the printout says so.
+ */
+void frugal_solvers(void) {
+    FrugalResult res[4];
+    int i, ida_gave_up;
+
+    res[0] = wall_follower();
+    res[1] = pledge();
+    res[2] = tremaux(maze);
+    res[3] = ida_bitset();
+    ida_gave_up = !res[3].found && res[3].moves >= MAX_IDA_EXPANSIONS;
+    print_maze(maze, 0);
+
+    set_color(YELLOW);
+    printf("%-22s %-9s %12s %7s %12s %10s\n", "Engine", "Result", "Moves", "Length", "Memory (B)", "Bits/cell");
+    set_color(WHITE);
+    for (i = 0; i < 4; i++) {
+        set_color(res[i].found ? GREEN : RED);
+        printf("%-22s %-9s", res[i].name, res[i].found ? "reached" : i == 3 && ida_gave_up ? "gave up" : "failed");
+        set_color(WHITE);
+        printf(" %12ld %7d %12lu", res[i].moves, res[i].length, (unsigned long)res[i].bytes);
+        if (res[i].bits_per_cell > 0) printf(" %10.2f\n", res[i].bits_per_cell);
+        else printf(" %10s\n", "O(1)");
+    }
+    printf("BFS for comparison: %lu bytes (%d bits/cell).\n",
+        (unsigned long)(BFS_BYTES_PER_CELL * rows * cols), (int)(8 * BFS_BYTES_PER_CELL));
+    printf("Moves: steps walked (followers, Tremaux) or cells expanded (IDA*).\n");
+
+    unsigned long long ram = available_memory();
+    if (ram > 0) {
+        printf("\nWith %llu MB of free RAM the largest solvable maze is about:\n", ram >> 20);
+        printf("  BFS: %llu cells, Tremaux: %llu cells,\n", ram / BFS_BYTES_PER_CELL, ram * 4);
+        printf("  wall follower / Pledge: any size the maze itself can be read in.\n");
+        printf("  IDA* would fit %llu cells (plus the path length), but is only practical\n", ram * 8);
+        printf("  on tree-like mazes or short paths: loops multiply the routes it retries.\n");
+        if (ida_gave_up) {
+            set_color(RED);
+            printf("  On this maze IDA* gave up after %ld expansions.\n", res[3].moves);
+            set_color(WHITE);
+        }
+    }
+}
+
+/** @} */
+
+/**
+ * @defgroup ExternalBFS External-Memory BFS (Disk-Backed Frontiers)
+ * @{
+ */
+
+ /**
+  * @brief A rectangular maze read in place from a mapped file of any size.
+  */
+typedef struct {
+    const char* data;           /**< Mapped file contents */
+    size_t size;                /**< File size in bytes */
+    size_t base;                /**< Offset of the first maze row (after leading directives) */
+    size_t stride;              /**< Bytes per row, including the line ending */
+    long long rows, cols;       /**< Maze dimensions */
+    long long start, exit;      /**< Cell indices r * cols + c of 'S' and 'E' (-1 if missing) */
+} ExtGrid;
+
+/**
+ * @brief A cell with its BFS level, as stored in the frontier and distance files.
+ */
+typedef struct {
+    unsigned long long cell;    /**< Cell index r * cols + c */
+    unsigned int dist;          /**< BFS level of the cell */
+} ExtRecord;
+
+/**
+ * @brief Collects records and sorts them externally: sorted runs go to temporary files.
+ */
+typedef struct {
+    ExtRecord* buf;             /**< In-memory run being filled */
+    size_t n;                   /**< Records in buf */
+    FILE* runs[EXT_FANIN];      /**< Sorted runs on disk */
+    int nruns;                  /**< Number of runs */
+} ExtSorter;
+
+unsigned long long ext_bytes_read;      /**< Bytes read from temporary files by the last external BFS */
+unsigned long long ext_bytes_written;   /**< Bytes written to temporary and output files */
+
+/**
+ * @brief Maps a maze file and checks that its rows form a rectangle.
+ * @details Leading directive lines are skipped and the maze ends at the first blank
+ *          line, as in load_maze. Every row must sit exactly one stride after the
+ *          previous one, so a cell is found by arithmetic without an index.
+ * @return 1 on success, 0 on failure (error printed)
+ */
+int ext_open_grid(const char* path, ExtGrid* g) {
+    size_t pos = 0;
+    g->data = map_file(path, &g->size);
+    if (g->data == NULL) {
+        set_color(RED);
+        printf("Error: %s cannot be mapped!\n", path);
+        set_color(WHITE);
+        return 0;
+    }
+
+    while (pos < g->size && g->data[pos] == ';') {
+        const char* nl = (const char*)memchr(g->data + pos, '\n', g->size - pos);
+        pos = nl ? (size_t)(nl - g->data) + 1 : g->size;
+    }
+    g->base = pos;
+    g->cols = 0;
+    while (pos + g->cols < g->size && g->data[pos + g->cols] != '\n' && g->data[pos + g->cols] != '\r') g->cols++;
+    g->stride = g->cols + (pos + g->cols < g->size && g->data[pos + g->cols] == '\r' ? 2 : 1);
+    g->rows = 0;
+    g->start = g->exit = -1;
+
+    while (g->cols > 0 && pos < g->size) {
+        const char* row = g->data + pos;
+        if (row[0] == '\n' || row[0] == '\r') break;              // blank line: end of the maze
+        if (pos + g->cols > g->size || (pos + g->cols < g->size && row[g->cols] != g->data[g->base + g->cols])) {
+            g->rows = -1;
+            break;
+        }
+        const char* hit = (const char*)memchr(row, 'S', g->cols);
+        if (hit) g->start = g->rows * g->cols + (hit - row);
+        hit = (const char*)memchr(row, 'E', g->cols);
+        if (hit) g->exit = g->rows * g->cols + (hit - row);
+        g->rows++;
+        pos += g->stride;
+    }
+
+    if (g->rows <= 0) {
+        set_color(RED);
+        printf("Error: All rows must have the same length!\n");
+        set_color(WHITE);
+        unmap_file(g->data, g->size);
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Tells whether a cell of the mapped maze is open.
+ */
+int ext_open_cell(const ExtGrid* g, long long r, long long c) {
+    return g->data[g->base + (size_t)r * g->stride + (size_t)c] != '#';
+}
+
+/**
+ * @brief Writes one record, counting the bytes written.
+ */
+void ext_write(FILE* f, const ExtRecord* rec) {
+    fwrite(rec, sizeof(ExtRecord), 1, f);
+    ext_bytes_written += sizeof(ExtRecord);
+}
+
+/**
+ * @brief Reads one record, counting the bytes read.
+ * @return 1 if a record was read, 0 at the end of the file
+ */
+int ext_read(FILE* f, ExtRecord* rec) {
+    if (fread(rec, sizeof(ExtRecord), 1, f) != 1) return 0;
+    ext_bytes_read += sizeof(ExtRecord);
+    return 1;
+}
+
+/**
+ * @brief qsort comparator ordering records by cell.
+ */
+int compare_records(const void* a, const void* b) {
+    unsigned long long x = ((const ExtRecord*)a)->cell, y = ((const ExtRecord*)b)->cell;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Merges sorted runs into one sorted file, dropping repeated cells, and closes the runs.
+ * @return The merged file rewound for reading, or NULL if no temporary file can be created
+ */
+FILE* ext_merge(FILE** runs, int n) {
+    ExtRecord head[EXT_FANIN];
+    int live[EXT_FANIN], i, have_last = 0;
+    unsigned long long last = 0;
+    FILE* out = tmpfile();
+
+    for (i = 0; i < n; i++) {
+        rewind(runs[i]);
+        live[i] = ext_read(runs[i], &head[i]);
+    }
+    while (out) {
+        int best = -1;
+        for (i = 0; i < n; i++) {
+            if (live[i] && (best == -1 || head[i].cell < head[best].cell)) best = i;
+        }
+        if (best == -1) break;
+        if (!have_last || head[best].cell != last) {
+            ext_write(out, &head[best]);
+            last = head[best].cell;
+            have_last = 1;
+        }
+        live[best] = ext_read(runs[best], &head[best]);
+    }
+    for (i = 0; i < n; i++) fclose(runs[i]);
+    if (out) rewind(out);
+    return out;
+}
+
+/**
+ * @brief Sorts the in-memory records and writes them to disk as a new run.
+ * @details When EXT_FANIN runs have piled up they are merged into one, so the
+ *          number of open files stays bounded.
+ * @return 1 on success, 0 if no temporary file can be created
+ */
+int ext_flush(ExtSorter* s) {
+    size_t i;
+    FILE* run = tmpfile();
+    if (!run) return 0;
+    qsort(s->buf, s->n, sizeof(ExtRecord), compare_records);
+    for (i = 0; i < s->n; i++) {
+        if (i == 0 || s->buf[i].cell != s->buf[i - 1].cell) ext_write(run, &s->buf[i]);
+    }
+    s->n = 0;
+    s->runs[s->nruns++] = run;
+    if (s->nruns == EXT_FANIN) {
+        s->runs[0] = ext_merge(s->runs, s->nruns);
+        s->nruns = 1;
+        if (!s->runs[0]) return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Adds a record to the sorter, spilling a run to disk when the buffer is full.
+ */
+int ext_add(ExtSorter* s, unsigned long long cell, unsigned int dist) {
+    s->buf[s->n].cell = cell;
+    s->buf[s->n].dist = dist;
+    return ++s->n < EXT_RUN_RECORDS || ext_flush(s);
+}
+
+/**
+ * @brief Finishes sorting: returns all added records, sorted and without repeated cells.
+ * @return A file rewound for reading (the sorter is left empty), or NULL on failure
+ */
+FILE* ext_sorted(ExtSorter* s) {
+    FILE* out;
+    if ((s->n > 0 || s->nruns == 0) && !ext_flush(s)) return NULL;
+    out = s->nruns == 1 ? s->runs[0] : ext_merge(s->runs, s->nruns);
+    s->nruns = 0;
+    if (out) rewind(out);
+    return out;
+}
+
+/**
+ * @brief Tells whether a sorted file contains a cell, advancing its cursor.
+ * @details Cells are asked for in increasing order, so each file is read once.
+ */
+int ext_contains(FILE* f, ExtRecord* cursor, int* live, unsigned long long cell) {
+    while (*live && cursor->cell < cell) *live = ext_read(f, cursor);
+    return *live && cursor->cell == cell;
+}
+
+/**
+ * @brief Breadth-first search whose frontiers live in sorted files (Munagala-Ranade).
+ * @details Level t + 1 is built by listing the neighbours of level t (read in cell
+ *          order, so the mapped maze is swept band by band), sorting them externally
+ *          and removing, in one merge, repeated cells and the cells of levels t and
+ *          t - 1 - in an undirected graph no other level can contain a neighbour.
+ *          Every file is read and written sequentially. Each settled cell is also
+ *          logged; the sorted log is finally expanded into a dense distance file.
+ * @param g Mapped maze
+ * @param out Receives rows * cols 32-bit distances after a small header
+ * @param levels Receives the number of BFS levels
+ * @param reached Receives the number of reachable cells
+ * @return Distance from 'S' to 'E' (-1 if unreachable), or -2 on an I/O failure
+ */
+long long ext_bfs(const ExtGrid* g, FILE* out, unsigned int* levels, unsigned long long* reached) {
+    ExtSorter next = { NULL, 0, { NULL }, 0 }, log = { NULL, 0, { NULL }, 0 };
+    FILE *prev = tmpfile(), *cur = tmpfile(), *found;
+    long long dist_exit = g->start == g->exit ? 0 : -1;
+    unsigned int level = 0;
+    int failed = 0;
+
+    next.buf = (ExtRecord*)malloc(sizeof(ExtRecord) * EXT_RUN_RECORDS);
+    log.buf = (ExtRecord*)malloc(sizeof(ExtRecord) * EXT_RUN_RECORDS);
+    if (!prev || !cur || !next.buf || !log.buf) failed = 1;
+    else {
+        ExtRecord rec = { (unsigned long long)g->start, 0 };
+        ext_write(cur, &rec);
+        failed = !ext_add(&log, rec.cell, 0);
+    }
+    *reached = 1;
+
+    while (!failed) {
+        ExtRecord rec, pc, cc;
+        unsigned long long count = 0;
+        int d;
+
+        rewind(cur);
+        while (!failed && ext_read(cur, &rec)) {
+            long long r = (long long)(rec.cell / g->cols), c = (long long)(rec.cell % g->cols);
+            for (d = 0; d < 4; d++) {
+                long long nr = r + dr[d], nc = c + dc[d];
+                if (nr < 0 || nr >= g->rows || nc < 0 || nc >= g->cols || !ext_open_cell(g, nr, nc)) continue;
+                if (!ext_add(&next, (unsigned long long)(nr * g->cols + nc), level + 1)) failed = 1;
+            }
+        }
+        found = failed ? NULL : ext_sorted(&next);
+        FILE* fresh = tmpfile();
+        if (!found || !fresh) {
+            failed = 1;
+            if (found) fclose(found);
+            if (fresh) fclose(fresh);
+            break;
+        }
+
+        int prev_live, cur_live;
+        rewind(prev);
+        rewind(cur);
+        prev_live = ext_read(prev, &pc);
+        cur_live = ext_read(cur, &cc);
+        while (ext_read(found, &rec)) {
+            if (ext_contains(prev, &pc, &prev_live, rec.cell) || ext_contains(cur, &cc, &cur_live, rec.cell)) continue;
+            ext_write(fresh, &rec);
+            if (!ext_add(&log, rec.cell, rec.dist)) failed = 1;
+            if ((long long)rec.cell == g->exit) dist_exit = rec.dist;
+            count++;
+        }
+        fclose(found);
+        fclose(prev);
+        prev = cur;
+        cur = fresh;
+        if (count == 0) break;
+        *reached += count;
+        level++;
+    }
+    *levels = level + 1;
+
+    // Expand the log, sorted by cell, into one distance per cell
+    found = failed ? NULL : ext_sorted(&log);
+    if (found) {
+        ExtRecord rec;
+        unsigned long long cell, total = (unsigned long long)g->rows * g->cols;
+        int live = ext_read(found, &rec);
+        fwrite("MZD1", 1, 4, out);
+        fwrite(&g->rows, sizeof(long long), 1, out);
+        fwrite(&g->cols, sizeof(long long), 1, out);
+        for (cell = 0; cell < total; cell++) {
+            unsigned int dist = EXT_UNREACHED;
+            if (live && rec.cell == cell) {
+                dist = rec.dist;
+                live = ext_read(found, &rec);
+            }
+            fwrite(&dist, sizeof(dist), 1, out);
+        }
+        ext_bytes_written += 4 + 2 * sizeof(long long) + total * sizeof(unsigned int);
+        fclose(found);
+    }
+    else failed = 1;
+
+    if (prev) fclose(prev);
+    if (cur) fclose(cur);
+    while (next.nruns > 0) fclose(next.runs[--next.nruns]);
+    while (log.nruns > 0) fclose(log.runs[--log.nruns]);
+    free(next.buf);
+    free(log.buf);
+    return failed ? -2 : dist_exit;
+}
+
+/**
+ * @brief Runs the external-memory BFS on a maze file and writes "<file>.dist".
+ * @details The distance file holds "MZD1", the row and column counts (64-bit), then
+ *          one 32-bit distance per cell in row order (EXT_UNREACHED for walls and
+ *          cells that cannot be reached).
+ */
+void external_bfs(void) {
+    char path[260], out_path[270];
+    ExtGrid g;
+    unsigned int levels = 0;
+    unsigned long long reached = 0;
+
+    set_color(CYAN);
+    printf("Maze file (Enter for %s): ", filename);
+    set_color(WHITE);
+    read_line(path, sizeof(path));
+    if (path[0] == '\0') strcpy(path, filename);
+
+    if (!ext_open_grid(path, &g)) {
+        wait_for_enter();
+        return;
+    }
+    if (g.start == -1 || g.exit == -1) {
+        set_color(RED);
+        printf("Maze must contain 'S' and 'E'!\n");
+        set_color(WHITE);
+        unmap_file(g.data, g.size);
+        wait_for_enter();
+        return;
+    }
+
+    sprintf(out_path, "%s.dist", path);
+    FILE* out = fopen(out_path, "wb");
+    if (out == NULL) {
+        set_color(RED);
+        printf("Error: %s cannot be created!\n", out_path);
+        set_color(WHITE);
+        unmap_file(g.data, g.size);
+        wait_for_enter();
+        return;
+    }
+
+    ext_bytes_read = ext_bytes_written = 0;
+    double started = wall_seconds();
+    long long dist = ext_bfs(&g, out, &levels, &reached);
+    int written = !ferror(out);
+    written = fclose(out) == 0 && written;
+    double seconds = wall_seconds() - started;
+    unmap_file(g.data, g.size);
+    if (dist == -2 || !written) remove(out_path);     // do not leave a truncated distance file behind
+
+    if (dist == -2) {
+        set_color(RED);
+        printf("Error: temporary files cannot be created or written!\n");
+        set_color(WHITE);
+        wait_for_enter();
+        return;
+    }
+
+    set_color(YELLOW);
+    printf("%lld x %lld maze: %u BFS levels, %llu reachable cells.\n", g.rows, g.cols, levels, reached);
+    set_color(dist >= 0 ? GREEN : RED);
+    if (dist >= 0) printf("Shortest path from S to E: %lld steps.\n", dist);
+    else printf("No path exists!\n");
+    set_color(WHITE);
+    printf("Disk traffic: %.1f MB read, %.1f MB written in %.2f s.\n",
+        ext_bytes_read / 1048576.0, ext_bytes_written / 1048576.0, seconds);
+    if (written) printf("Distances written to %s.\n", out_path);
+    else {
+        set_color(RED);
+        printf("Error: %s cannot be written!\n", out_path);
+        set_color(WHITE);
+    }
+    wait_for_enter();
+}
+
+/** @} */
+
+/**
+ * @defgroup Partitioned Partitioned Multi-Process BFS (Halo Exchange)
+ * @{
+ */
+
+#ifdef _WIN32
+typedef HANDLE channel_t;           /**< One end of a pipe between processes */
+#define STDIN_CHANNEL  GetStdHandle(STD_INPUT_HANDLE)
+#define STDOUT_CHANNEL GetStdHandle(STD_OUTPUT_HANDLE)
+#else
+typedef int channel_t;              /**< One end of a pipe between processes */
+#define STDIN_CHANNEL  0
+#define STDOUT_CHANNEL 1
+#endif
+
+ /**
+  * @brief The coordinator's view of one worker process.
+  */
+typedef struct {
+    channel_t to;               /**< Pipe carrying cells to the worker */
+    channel_t from;             /**< Pipe carrying the worker's replies */
+#ifdef _WIN32
+    HANDLE process;             /**< Worker process handle */
+#else
+    pid_t pid;                  /**< Worker process id */
+#endif
+} PartitionProc;
+
+/**
+ * @brief Writes exactly n bytes to a pipe.
+ * @return 1 on success, 0 if the other end is gone
+ */
+int channel_write(channel_t ch, const void* buf, size_t n) {
+    const char* p = (const char*)buf;
+    while (n > 0) {
+#ifdef _WIN32
+        DWORD done;
+        if (!WriteFile(ch, p, (DWORD)n, &done, NULL) || done == 0) return 0;
+#else
+        ssize_t done = write(ch, p, n);
+        if (done <= 0) return 0;
+#endif
+        p += done;
+        n -= (size_t)done;
+    }
+    return 1;
+}
+
+/**
+ * @brief Reads exactly n bytes from a pipe.
+ * @return 1 on success, 0 if the other end is gone
+ */
+int channel_read(channel_t ch, void* buf, size_t n) {
+    char* p = (char*)buf;
+    while (n > 0) {
+#ifdef _WIN32
+        DWORD done;
+        if (!ReadFile(ch, p, (DWORD)n, &done, NULL) || done == 0) return 0;
+#else
+        ssize_t done = read(ch, p, n);
+        if (done <= 0) return 0;
+#endif
+        p += done;
+        n -= (size_t)done;
+    }
+    return 1;
+}
+
+/**
+ * @brief First row of partition k when the rows are split into n bands.
+ */
+int partition_first_row(int k, int n) {
+    return (int)((long)rows * k / n);
+}
+
+/**
+ * @brief Body of a worker process: BFS over its own band of rows, one level per round.
+ * @details Each round the worker receives the cells other partitions discovered in
+ *          its band (the halo), adopts those it has not seen, and expands its
+ *          frontier. Neighbours in its band are settled at once; neighbours owned
+ *          by other partitions (across the band edge, around a wrap or through a
+ *          portal) are sent back to the coordinator for routing. A negative cell
+ *          count ends the search, after which the band's distances are returned.
+ * @param part Index of this partition
+ * @param parts Number of partitions
+ * @param in Pipe from the coordinator
+ * @param out Pipe to the coordinator
+ */
+void partition_worker(int part, int parts, channel_t in, channel_t out) {
+    static int dist[MAXR][MAXC];
+    static int frontier[QSIZE], next[QSIZE], outbox[NUM_MOVES * QSIZE];
+    int r0 = partition_first_row(part, parts), r1 = partition_first_row(part + 1, parts);
+    int nf = 0, level = 0, i, j, m;
+
+    for (i = r0; i < r1; i++) {
+        for (j = 0; j < cols; j++) dist[i][j] = -1;
+    }
+
+    while (channel_read(in, &m, sizeof(int)) && m >= 0) {
+        for (i = 0; i < m; i++) {
+            int cell;
+            if (!channel_read(in, &cell, sizeof(int))) return;
+            if (dist[cell / MAXC][cell % MAXC] == -1) {
+                dist[cell / MAXC][cell % MAXC] = level;
+                frontier[nf++] = cell;
+            }
+        }
+
+        int nn = 0, no = 0, d;
+        for (i = 0; i < nf; i++) {
+            int cr = frontier[i] / MAXC, cc = frontier[i] % MAXC;
+            for (d = 0; d < NUM_MOVES; d++) {
+                int nr, nc;
+                if (!neighbor_cell(cr, cc, d, &nr, &nc) || !is_valid(nr, nc)) continue;
+                if (nr < r0 || nr >= r1) outbox[no++] = nr * MAXC + nc;
+                else if (dist[nr][nc] == -1) {
+                    dist[nr][nc] = level + 1;
+                    next[nn++] = nr * MAXC + nc;
+                }
+            }
+        }
+        if (!channel_write(out, &nn, sizeof(int)) || !channel_write(out, &no, sizeof(int)) ||
+            !channel_write(out, outbox, sizeof(int) * no)) return;
+
+        memcpy(frontier, next, sizeof(int) * nn);
+        nf = nn;
+        level++;
+    }
+
+    for (i = r0; i < r1; i++) {
+        if (!channel_write(out, dist[i], sizeof(int) * cols)) return;
+    }
+}
+
+/**
+ * @brief Starts worker process k of n with a pipe in each direction.
+ * @details On POSIX the worker is a fork of this process. On Windows the program
+ *          starts itself again with PARTITION_WORKER_FLAG, the worker reloads the
+ *          maze file, and the pipes become its standard input and output.
+ * @return 1 on success, 0 on failure
+ */
+int start_partition(PartitionProc* procs, int k, int n) {
+#ifdef _WIN32
+    SECURITY_ATTRIBUTES sa = { sizeof(SECURITY_ATTRIBUTES), NULL, TRUE };
+    HANDLE in_r, in_w, out_r, out_w;
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    char exe[MAX_PATH], cmd[MAX_PATH + 64];
+
+    if (!CreatePipe(&in_r, &in_w, &sa, 0)) return 0;
+    if (!CreatePipe(&out_r, &out_w, &sa, 0)) {
+        CloseHandle(in_r);
+        CloseHandle(in_w);
+        return 0;
+    }
+    SetHandleInformation(in_w, HANDLE_FLAG_INHERIT, 0);
+    SetHandleInformation(out_r, HANDLE_FLAG_INHERIT, 0);
+
+    memset(&si, 0, sizeof(si));
+    si.cb = sizeof(si);
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = in_r;
+    si.hStdOutput = out_w;
+    si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    GetModuleFileNameA(NULL, exe, MAX_PATH);
+    sprintf(cmd, "\"%s\" %s %d %d", exe, PARTITION_WORKER_FLAG, k, n);
+
+    int ok = CreateProcessA(NULL, cmd, NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi);
+    CloseHandle(in_r);
+    CloseHandle(out_w);
+    if (!ok) {
+        CloseHandle(in_w);
+        CloseHandle(out_r);
+        return 0;
+    }
+    CloseHandle(pi.hThread);
+    procs[k].process = pi.hProcess;
+    procs[k].to = in_w;
+    procs[k].from = out_r;
+    return 1;
+#else
+    int down[2], up[2], i;
+    if (pipe(down) != 0) return 0;
+    if (pipe(up) != 0) {
+        close(down[0]);
+        close(down[1]);
+        return 0;
+    }
+
+    fflush(stdout);             // or the child would print the buffered output again
+    pid_t pid = fork();
+    if (pid == 0) {
+        for (i = 0; i < k; i++) {
+            close(procs[i].to);
+            close(procs[i].from);
+        }
+        close(down[1]);
+        close(up[0]);
+        partition_worker(k, n, down[0], up[1]);
+        _exit(0);
+    }
+    close(down[0]);
+    close(up[1]);
+    if (pid < 0) {
+        close(down[1]);
+        close(up[0]);
+        return 0;
+    }
+    procs[k].pid = pid;
+    procs[k].to = down[1];
+    procs[k].from = up[0];
+    return 1;
+#endif
+}
+
+/**
+ * @brief Closes the pipes of a worker and waits for it to exit.
+ */
+void finish_partition(PartitionProc* p) {
+#ifdef _WIN32
+    CloseHandle(p->to);
+    CloseHandle(p->from);
+    WaitForSingleObject(p->process, INFINITE);
+    CloseHandle(p->process);
+#else
+    close(p->to);
+    close(p->from);
+    waitpid(p->pid, NULL, 0);
+#endif
+}
+
+/**
+ * @brief Coordinates a BFS from 'S' over n worker processes, each owning a band of rows.
+ * @details Rounds are synchronous: the coordinator sends every worker the halo cells
+ *          that fall in its band, then collects each worker's next frontier size and
+ *          outgoing cells. The search ends when no worker has a frontier and no cell
+ *          is in flight; the bands' distances are then gathered. On POSIX, SIGPIPE is
+ *          ignored meanwhile, so writing to a worker that died fails with EPIPE and is
+ *          reported instead of killing the game.
+ * @param n Number of partitions
+ * @param dist Receives the distance of every cell (-1 if unreachable)
+ * @param rounds Receives the number of BFS rounds
+ * @param exchanged Receives the number of cells sent between partitions
+ * @return 1 on success, 0 if a worker could not be started or failed
+ */
+int partitioned_bfs(int n, int dist[MAXR][MAXC], int* rounds, long* exchanged) {
+    static int pending[NUM_MOVES * QSIZE], routed[NUM_MOVES * QSIZE];
+    PartitionProc procs[MAX_PARTITIONS];
+    int owner[MAXR];
+    int started = 0, ok = 1, np = 1, k, i;
+#ifndef _WIN32
+    void (*old_sigpipe)(int) = signal(SIGPIPE, SIG_IGN);
+#endif
+
+    for (k = 0; k < n; k++) {
+        for (i = partition_first_row(k, n); i < partition_first_row(k + 1, n); i++) owner[i] = k;
+    }
+    for (k = 0; k < n && ok; k++) {
+        ok = start_partition(procs, k, n);
+        if (ok) started++;
+    }
+
+    pending[0] = sr * MAXC + sc;
+    *rounds = 0;
+    *exchanged = 0;
+    while (ok) {
+        int active = 0, nr = 0;
+        for (k = 0; k < n && ok; k++) {
+            int m = 0;
+            for (i = 0; i < np; i++) {
+                if (owner[pending[i] / MAXC] == k) routed[m++] = pending[i];
+            }
+            ok = channel_write(procs[k].to, &m, sizeof(int)) && channel_write(procs[k].to, routed, sizeof(int) * m);
+        }
+        for (k = 0; k < n && ok; k++) {
+            int frontier, m;
+            ok = channel_read(procs[k].from, &frontier, sizeof(int)) && channel_read(procs[k].from, &m, sizeof(int)) &&
+                channel_read(procs[k].from, pending + nr, sizeof(int) * m);
+            active += frontier;
+            nr += m;
+        }
+        if (!ok) break;
+        (*rounds)++;
+        *exchanged += nr;
+        np = nr;
+        if (active == 0 && nr == 0) break;
+    }
+
+    for (k = 0; k < n && ok; k++) {
+        int stop = -1;
+        ok = channel_write(procs[k].to, &stop, sizeof(int));
+    }
+    for (k = 0; k < n && ok; k++) {
+        for (i = partition_first_row(k, n); i < partition_first_row(k + 1, n) && ok; i++) {
+            ok = channel_read(procs[k].from, dist[i], sizeof(int) * cols);
+        }
+    }
+    for (k = 0; k < started; k++) finish_partition(&procs[k]);
+#ifndef _WIN32
+    if (old_sigpipe != SIG_ERR) signal(SIGPIPE, old_sigpipe);
+#endif
+    return ok && started == n;
+}
+
+/**
+ * @brief Runs the partitioned BFS with 1, 2, 4, ... worker processes and checks each
+ *        result against the single-process BFS.
+ */
+void partitioned_analysis(void) {
+    static int expect[MAXR][MAXC], got[MAXR][MAXC];
+    static int order[QSIZE];
+    int n, i, j;
+
+    bfs_distances(sr, sc, 0, expect, order);
+    set_color(YELLOW);
+    printf("%-11s %8s %12s %10s  %s\n", "Processes", "Rounds", "Exchanged", "Time (ms)", "Matches BFS");
+    set_color(WHITE);
+
+    for (n = 1; n <= MAX_PARTITIONS && n <= rows; n *= 2) {
+        int rounds, same = 1;
+        long exchanged;
+        double started = wall_seconds();
+        if (!partitioned_bfs(n, got, &rounds, &exchanged)) {
+            set_color(RED);
+            printf("Worker processes could not be started or stopped responding!\n");
+            set_color(WHITE);
+            break;
+        }
+        double ms = (wall_seconds() - started) * 1000;
+
+        for (i = 0; i < rows; i++) {
+            for (j = 0; j < cols; j++) {
+                if (got[i][j] != expect[i][j]) same = 0;
+            }
+        }
+        printf("%-11d %8d %12ld %10.2f  ", n, rounds, exchanged, ms);
+        set_color(same ? GREEN : RED);
+        printf("%s\n", same ? "yes" : "NO");
+        set_color(WHITE);
+    }
+
+    if (expect[er][ec] == -1) printf("No path exists!\n");
+    else printf("Shortest path from S to E: %d steps.\n", expect[er][ec]);
+}
+
+/** @} */
+
+/**
+ * @defgroup Batch Corpus Batch Solver
+ * @{
+ */
+
+#define BATCH_OK            0       /**< Solved: a path exists */
+#define BATCH_NO_PATH       1       /**< Parsed, but 'E' cannot be reached */
+#define BATCH_UNREADABLE    2       /**< The file cannot be opened */
+#define BATCH_TOO_LARGE     3       /**< More than MAXR rows / MAXC columns or BATCH_MAX_FILE bytes */
+#define BATCH_BAD_ROWS      4       /**< Empty maze or rows of different lengths */
+#define BATCH_NO_ENDS       5       /**< 'S' or 'E' missing */
+#define BATCH_BAD_PORTAL    6       /**< A portal character does not occur exactly twice */
+#define BATCH_BAD_DIRECTIVE 7       /**< Unknown directive line */
+#define BATCH_STATUSES      8       /**< Number of status codes */
+
+/**
+ * @brief Status names written to the results file.
+ */
+const char* batch_status_name[BATCH_STATUSES] = {
+    "ok", "no_path", "unreadable", "too_large", "bad_rows", "no_start_or_exit", "bad_portal", "bad_directive"
+};
+
+/**
+ * @brief Move that enters a cell from its neighbour in direction d (so up gives 'D').
+ */
+const char batch_move_name[] = "DURL";
+
+/**
+ * @brief A maze parsed into private storage, so several can be solved at once.
+ * @details Holds what bfs_shortest uses: walls, the last 'S' and 'E', wrap-around
+ *          and portal links. Keys, doors and gates do not affect BFS and are kept
+ *          as open cells.
+ */
+typedef struct {
+    char cell[MAXR][MAXC];          /**< Maze characters */
+    int rows, cols;                 /**< Dimensions */
+    int sr, sc, er, ec;             /**< Start and exit */
+    int wrap;                       /**< 1 if the ";wrap" directive is present */
+    int portals;                    /**< Number of portal pairs */
+    unsigned long long hash;        /**< grid_hash of the maze */
+    int portal_to[MAXR][MAXC];      /**< Partner cell of each portal (-1 elsewhere) */
+} MazeGrid;
+
+/**
+ * @brief Result of one maze of the batch.
+ */
+typedef struct {
+    int status;                 /**< One of the BATCH_ codes */
+    int rows, cols;             /**< Dimensions (0 if not parsed) */
+    int length;                 /**< Shortest S-E path length (-1 if none) */
+    int reached;                /**< Cells reachable from 'S' */
+    char* moves;                /**< Moves of the path (see batch_move_name), NULL if none */
+} BatchResult;
+
+/**
+ * @brief A parsed maze on its way from a reader to a solver.
+ */
+typedef struct {
+    int index;                  /**< File the maze came from */
+    MazeGrid grid;              /**< Parsed maze */
+} BatchItem;
+
+/**
+ * @brief State shared by the batch stages.
+ * @details Readers take files through an atomic counter, parse them into spare
+ *          items and pass them to the solvers through the ready queue; solvers
+ *          hand the items back through the spare queue.
+ */
+typedef struct {
+    char** files;               /**< Paths of the mazes */
+    BatchResult* results;       /**< One result per file */
+    int count;                  /**< Number of files */
+    volatile int next;          /**< Index of the next file to read */
+    volatile int lane_solved;   /**< Mazes solved by the lane BFS */
+    volatile int cache_hits;    /**< Results taken from the solution cache */
+    int readers;                /**< Reader threads used (0 if io_uring read every file) */
+    BoundedQueue ready;         /**< Parsed mazes waiting for a solver */
+    BoundedQueue spare;         /**< Unused items */
+} BatchRun;
+
+/**
+ * @brief Scratch space of one solver thread.
+ */
+typedef struct {
+    BatchRun* run;              /**< Shared state */
+    int (*dist)[MAXC];          /**< BFS distances */
+    int* queue;                 /**< BFS queue */
+    struct LaneGroup* lanes;    /**< Small mazes waiting for the lane BFS */
+    unsigned long long* levels; /**< Frontier snapshots of the lane BFS */
+    size_t level_cap;           /**< Snapshots that fit in levels */
+    MazeGrid* spill;            /**< Lane maze rebuilt for solve_grid when the lane BFS runs out of memory */
+} BatchSolver;
+
+/**
+ * @brief Parses maze text like load_maze, but into a MazeGrid and without printing.
+ * @param text File contents
+ * @param len Length of text in bytes
+ * @param g Receives the maze
+ * @return BATCH_OK or an error code
+ */
+int parse_grid(const char* text, size_t len, MazeGrid* g) {
+    int first[256], count[256];
+    size_t pos = 0;
+    int i, j;
+
+    g->rows = g->cols = 0;
+    g->wrap = 0;
+    g->sr = g->er = -1;
+    g->portals = 0;
+    while (pos < len) {
+        const char* nl = (const char*)memchr(text + pos, '\n', len - pos);
+        size_t end = nl ? (size_t)(nl - text) : len, n = end - pos;
+        const char* line = text + pos;
+        pos = end + 1;
+        if (n > 0 && line[n - 1] == '\r') n--;
+
+        if (n == 0) {
+            if (g->rows > 0) break;     // a blank line ends the first floor
+            continue;
+        }
+        if (line[0] == ';') {
+            if (n == 5 && memcmp(line, ";wrap", 5) == 0) g->wrap = 1;
+            else if (n < 6 || memcmp(line, ";gate ", 6) != 0) return BATCH_BAD_DIRECTIVE;
+            continue;
+        }
+        if (g->rows == MAXR || n >= MAXC) return BATCH_TOO_LARGE;
+        if (g->rows == 0) g->cols = (int)n;
+        else if ((int)n != g->cols) return BATCH_BAD_ROWS;
+
+        memcpy(g->cell[g->rows], line, n);
+        g->cell[g->rows][n] = '\0';
+        g->rows++;
+    }
+    if (g->rows == 0) return BATCH_BAD_ROWS;
+
+    for (i = 0; i < 256; i++) {
+        first[i] = -1;
+        count[i] = 0;
+    }
+    for (i = 0; i < g->rows; i++) {
+        for (j = 0; j < g->cols; j++) {
+            unsigned char ch = (unsigned char)g->cell[i][j];
+            g->portal_to[i][j] = -1;
+            if (ch == 'S') {
+                g->sr = i;
+                g->sc = j;
+            }
+            else if (ch == 'E') {
+                g->er = i;
+                g->ec = j;
+            }
+            else if (strchr(PORTAL_CHARS, ch) != NULL && ch != '\0') {
+                if (count[ch]++ == 0) first[ch] = i * MAXC + j;
+                else {
+                    g->portal_to[i][j] = first[ch];
+                    g->portal_to[first[ch] / MAXC][first[ch] % MAXC] = i * MAXC + j;
+                }
+            }
+        }
+    }
+    if (g->sr == -1 || g->er == -1) return BATCH_NO_ENDS;
+    for (i = 0; i < 256; i++) {
+        if (count[i] != 0 && count[i] != 2) return BATCH_BAD_PORTAL;
+        if (count[i] == 2) g->portals++;
+    }
+    g->hash = grid_hash((const char(*)[MAXC])g->cell, g->rows, g->cols, g->sr, g->sc, g->er, g->ec, g->wrap);
+    return BATCH_OK;
+}
+
+/**
+ * @brief Fills the solution-cache key of a parsed batch maze.
+ */
+void batch_cache_key(CacheRecord* rec, const MazeGrid* g) {
+    memset(rec, 0, sizeof(*rec));
+    rec->hash = g->hash;
+    rec->algo = CACHE_BATCH;
+    rec->rows = g->rows;
+    rec->cols = g->cols;
+    rec->sr = g->sr;
+    rec->sc = g->sc;
+    rec->er = g->er;
+    rec->ec = g->ec;
+}
+
+/**
+ * @brief Stores a batch result in the solution cache under the given key.
+ */
+void batch_cache_store(CacheRecord* key, const BatchResult* res) {
+    if (res->length != -1 && res->moves == NULL) return;     // out of memory: the moves are missing
+    key->length = res->length;
+    key->reached = res->reached;
+    cache_store(key, res->moves ? res->moves : "");
+}
+
+/**
+ * @brief Computes the cell one step away in direction d in a MazeGrid, without portals.
+ * @return 1 if the step exists, 0 otherwise
+ */
+int grid_step(const MazeGrid* g, int r, int c, int d, int* nr, int* nc) {
+    *nr = r + dr[d];
+    *nc = c + dc[d];
+    if (g->wrap) {
+        *nr = (*nr + g->rows) % g->rows;
+        *nc = (*nc + g->cols) % g->cols;
+        return 1;
+    }
+    return *nr >= 0 && *nr < g->rows && *nc >= 0 && *nc < g->cols;
+}
+
+/**
+ * @brief Computes the cell reached by move d in a MazeGrid (the counterpart of neighbor_cell).
+ * @return 1 if the move exists, 0 otherwise
+ */
+int grid_neighbor(const MazeGrid* g, int r, int c, int d, int* nr, int* nc) {
+    int p;
+    if (!grid_step(g, r, c, d, nr, nc)) return 0;
+    p = g->portal_to[*nr][*nc];
+    if (p != -1) {
+        *nr = p / MAXC;
+        *nc = p % MAXC;
+    }
+    return 1;
+}
+
+/**
+ * @brief Spells out the path to 'E' from BFS distances.
+ * @details Walks back from 'E', stepping to the first neighbour (in move order) one
+ *          step closer to 'S', so every solver that follows this rule returns the same path.
+ *          A portal cell is only ever entered by stepping onto its partner, so its
+ *          neighbours are looked up around the partner.
+ * @return Malloc'ed string of dist at 'E' moves, or NULL if out of memory
+ */
+char* grid_moves(const MazeGrid* g, int dist[MAXR][MAXC]) {
+    int len = dist[g->er][g->ec], r = g->er, c = g->ec, k, d, nr = 0, nc = 0;
+    char* moves = (char*)malloc(len + 1);
+    if (moves == NULL) return NULL;
+
+    moves[len] = '\0';
+    for (k = len; k > 0; k--) {
+        int p = g->portal_to[r][c];
+        if (p != -1) {
+            r = p / MAXC;
+            c = p % MAXC;
+        }
+        for (d = 0; d < NUM_MOVES; d++) {
+            if (grid_step(g, r, c, d, &nr, &nc) && dist[nr][nc] == k - 1) break;
+        }
+        moves[k - 1] = batch_move_name[d];
+        r = nr;
+        c = nc;
+    }
+    return moves;
+}
+
+/**
+ * @brief BFS from 'S' on a MazeGrid, filling the length, reached and moves fields of a result.
+ * @param g Parsed maze
+ * @param dist Scratch distance grid
+ * @param queue Scratch queue of QSIZE entries
+ * @param res Receives the result
+ */
+void solve_grid(const MazeGrid* g, int dist[MAXR][MAXC], int* queue, BatchResult* res) {
+    int head = 0, tail = 0, i, j, d;
+
+    for (i = 0; i < g->rows; i++) {
+        for (j = 0; j < g->cols; j++) dist[i][j] = -1;
+    }
+    dist[g->sr][g->sc] = 0;
+    queue[tail++] = g->sr * MAXC + g->sc;
+    while (head < tail) {
+        int cr = queue[head] / MAXC, cc = queue[head] % MAXC;
+        head++;
+        for (d = 0; d < NUM_MOVES; d++) {
+            int nr, nc;
+            if (!grid_neighbor(g, cr, cc, d, &nr, &nc)) continue;
+            if (g->cell[nr][nc] == '#' || dist[nr][nc] != -1) continue;
+            dist[nr][nc] = dist[cr][cc] + 1;
+            queue[tail++] = nr * MAXC + nc;
+        }
+    }
+
+    res->rows = g->rows;
+    res->cols = g->cols;
+    res->reached = tail;
+    res->length = dist[g->er][g->ec];
+    res->status = res->length == -1 ? BATCH_NO_PATH : BATCH_OK;
+    res->moves = res->length == -1 ? NULL : grid_moves(g, dist);
+}
+
+/**
+ * @brief Up to BATCH_LANES small mazes searched together, one 64-bit word per row.
+ * @details Words are stored [row][lane] so each step of the BFS is the same shift
+ *          and mask applied to every lane, a loop the compiler turns into SIMD
+ *          instructions (two to eight lanes per instruction, depending on the target).
+ */
+typedef struct LaneGroup {
+    int count;                                      /**< Lanes in use */
+    int index[BATCH_LANES];                         /**< File of each lane */
+    int rows[BATCH_LANES], cols[BATCH_LANES];       /**< Dimensions */
+    int sr[BATCH_LANES], sc[BATCH_LANES];           /**< Start of each lane */
+    int er[BATCH_LANES], ec[BATCH_LANES];           /**< Exit of each lane */
+    unsigned long long wrap[BATCH_LANES];           /**< All ones if the lane wraps around */
+    CacheRecord key[BATCH_LANES];                   /**< Solution-cache key of each lane */
+    unsigned long long open[LANE_SIZE][BATCH_LANES];/**< Bit c of row r is set for open cells */
+} LaneGroup;
+
+/**
+ * @brief Checks whether a maze can be solved by the lane BFS (at most 64x64, no portals).
+ */
+int lane_fits(const MazeGrid* g) {
+    return g->rows <= LANE_SIZE && g->cols <= LANE_SIZE && g->portals == 0;
+}
+
+/**
+ * @brief Packs a maze into the next free lane of a group.
+ */
+void lane_add(LaneGroup* grp, const MazeGrid* g, int index) {
+    int l = grp->count++, r, c;
+    grp->index[l] = index;
+    grp->rows[l] = g->rows;
+    grp->cols[l] = g->cols;
+    grp->sr[l] = g->sr;
+    grp->sc[l] = g->sc;
+    grp->er[l] = g->er;
+    grp->ec[l] = g->ec;
+    grp->wrap[l] = g->wrap ? ~0ULL : 0;
+    batch_cache_key(&grp->key[l], g);
+    for (r = 0; r < LANE_SIZE; r++) {
+        unsigned long long bits = 0;
+        for (c = 0; r < g->rows && c < g->cols; c++) {
+            if (g->cell[r][c] != '#') bits |= 1ULL << c;
+        }
+        grp->open[r][l] = bits;
+    }
+}
+
+/**
+ * @brief Rebuilds lane l of a group as a MazeGrid of walls and open cells.
+ */
+void lane_unpack(const LaneGroup* grp, int l, MazeGrid* g) {
+    int r, c;
+    g->rows = grp->rows[l];
+    g->cols = grp->cols[l];
+    g->sr = grp->sr[l];
+    g->sc = grp->sc[l];
+    g->er = grp->er[l];
+    g->ec = grp->ec[l];
+    g->wrap = grp->wrap[l] != 0;
+    g->portals = 0;
+    g->hash = grp->key[l].hash;
+    for (r = 0; r < g->rows; r++) {
+        for (c = 0; c < g->cols; c++) {
+            g->cell[r][c] = grp->open[r][l] >> c & 1 ? ' ' : '#';
+            g->portal_to[r][c] = -1;
+        }
+    }
+}
+
+/**
+ * @brief Counts the set bits of a word.
+ */
+int popcount64(unsigned long long x) {
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+}
+
+/**
+ * @brief Computes the cell reached by move d (0-3) in lane l of a group.
+ * @return 1 if the move stays inside the maze, 0 otherwise
+ */
+int lane_neighbor(const LaneGroup* grp, int l, int r, int c, int d, int* nr, int* nc) {
+    *nr = r + dr[d];
+    *nc = c + dc[d];
+    if (grp->wrap[l]) {
+        *nr = (*nr + grp->rows[l]) % grp->rows[l];
+        *nc = (*nc + grp->cols[l]) % grp->cols[l];
+        return 1;
+    }
+    return *nr >= 0 && *nr < grp->rows[l] && *nc >= 0 && *nc < grp->cols[l];
+}
+
+/**
+ * @brief Computes the next frontier words of one row for every lane and marks them seen.
+ * @details out = (row shifted left and right | the rows above and below) & open & ~seen,
+ *          two lanes per SSE2 instruction where available.
+ * @return Nonzero if any lane gained a cell
+ */
+int lane_expand(const unsigned long long* above, const unsigned long long* row, const unsigned long long* below,
+    const unsigned long long* open, unsigned long long* seen, unsigned long long* out) {
+    int l;
+#ifdef HAVE_SSE2
+    __m128i any = _mm_setzero_si128();
+    for (l = 0; l < BATCH_LANES; l += 2) {
+        __m128i f = _mm_loadu_si128((const __m128i*)(row + l));
+        __m128i was = _mm_loadu_si128((const __m128i*)(seen + l));
+        __m128i step = _mm_or_si128(_mm_slli_epi64(f, 1), _mm_srli_epi64(f, 1));
+        step = _mm_or_si128(step, _mm_loadu_si128((const __m128i*)(above + l)));
+        step = _mm_or_si128(step, _mm_loadu_si128((const __m128i*)(below + l)));
+        step = _mm_andnot_si128(was, _mm_and_si128(step, _mm_loadu_si128((const __m128i*)(open + l))));
+        _mm_storeu_si128((__m128i*)(out + l), step);
+        _mm_storeu_si128((__m128i*)(seen + l), _mm_or_si128(was, step));
+        any = _mm_or_si128(any, step);
+    }
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(any, _mm_setzero_si128())) != 0xFFFF;
+#else
+    unsigned long long any = 0;
+    for (l = 0; l < BATCH_LANES; l++) {
+        out[l] = ((row[l] << 1) | (row[l] >> 1) | above[l] | below[l]) & open[l] & ~seen[l];
+        seen[l] |= out[l];
+        any |= out[l];
+    }
+    return any != 0;
+#endif
+}
+
+/**
+ * @brief Bit-parallel BFS of every lane of a group at once.
+ * @details Each level computes the next frontier of all lanes with shifts, ORs and
+ *          masks, and keeps a snapshot of it until every exit is found; paths are then
+ *          traced back through the snapshots with the same rule as grid_moves.
+ *          If the snapshots cannot grow, the BFS still runs to the end, and lanes whose
+ *          exit lies beyond the last snapshot are rebuilt and solved by solve_grid.
+ * @param grp Mazes to solve; emptied on return
+ * @param solver Owner of the snapshot buffer (grown as needed) and of the scratch space of solve_grid
+ * @param results Result array, indexed by the lanes' file indices
+ */
+void lane_solve(LaneGroup* grp, BatchSolver* solver, BatchResult* results) {
+    unsigned long long buffers[2][LANE_SIZE + 2][BATCH_LANES];    // row r is at r + 1; rows 0 and LANE_SIZE + 1 stay empty
+    unsigned long long visited[LANE_SIZE][BATCH_LANES];
+    unsigned long long (*frontier)[BATCH_LANES] = buffers[0], (*next)[BATCH_LANES] = buffers[1], (*swap)[BATCH_LANES];
+    int found[BATCH_LANES], missing = grp->count, levels = 0, depth = 0, height = 0, out_of_memory = 0, r, l;
+    const size_t level_words = LANE_SIZE * BATCH_LANES;
+
+    for (l = grp->count; l < BATCH_LANES; l++) {
+        for (r = 0; r < LANE_SIZE; r++) grp->open[r][l] = 0;
+        grp->wrap[l] = 0;
+    }
+    memset(buffers, 0, sizeof(buffers));
+    for (l = 0; l < grp->count; l++) {
+        found[l] = -1;
+        frontier[grp->sr[l] + 1][l] = 1ULL << grp->sc[l];
+        if (grp->rows[l] > height) height = grp->rows[l];
+    }
+    memcpy(visited, frontier[1], sizeof(visited));
+
+    while (1) {
+        int any = 0;
+        if (missing > 0 && !out_of_memory) {
+            if ((size_t)levels == solver->level_cap) {
+                size_t cap = solver->level_cap ? solver->level_cap * 2 : 256;
+                unsigned long long* grown = (unsigned long long*)realloc(solver->levels, cap * level_words * sizeof(unsigned long long));
+                if (grown != NULL) {
+                    solver->levels = grown;
+                    solver->level_cap = cap;
+                }
+                else out_of_memory = 1;
+            }
+            if (!out_of_memory) {
+                memcpy(solver->levels + levels * level_words, frontier[1], height * BATCH_LANES * sizeof(unsigned long long));
+                levels++;
+            }
+        }
+        depth++;
+
+        for (r = 0; r < height; r++) {
+            any |= lane_expand(frontier[r], frontier[r + 1], frontier[r + 2], grp->open[r], visited[r], next[r + 1]);
+        }
+        for (l = 0; l < grp->count; l++) {
+            int bottom = grp->rows[l] - 1, last = grp->cols[l] - 1;
+            if (!grp->wrap[l]) continue;
+            for (r = 0; r <= bottom; r++) {
+                unsigned long long f = frontier[r + 1][l];
+                unsigned long long step = ((f >> last) | (f << last)) & grp->open[r][l] & ~visited[r][l];
+                if (r == 0) step |= frontier[bottom + 1][l] & grp->open[0][l] & ~visited[0][l];
+                if (r == bottom) step |= frontier[1][l] & grp->open[bottom][l] & ~visited[bottom][l];
+                next[r + 1][l] |= step;
+                visited[r][l] |= step;
+                any |= step != 0;
+            }
+        }
+        swap = frontier;
+        frontier = next;
+        next = swap;
+        for (l = 0; l < grp->count; l++) {
+            if (found[l] == -1 && (frontier[grp->er[l] + 1][l] >> grp->ec[l] & 1)) {
+                found[l] = depth;
+                missing--;
+            }
+        }
+        if (any == 0) break;
+    }
+
+    for (l = 0; l < grp->count; l++) {
+        BatchResult* res = &results[grp->index[l]];
+        int reached = 0, k, d, cr = grp->er[l], cc = grp->ec[l], nr = 0, nc = 0;
+        if (found[l] > levels) {
+            lane_unpack(grp, l, solver->spill);
+            solve_grid(solver->spill, solver->dist, solver->queue, res);
+            continue;
+        }
+        for (r = 0; r < grp->rows[l]; r++) reached += popcount64(visited[r][l]);
+        res->rows = grp->rows[l];
+        res->cols = grp->cols[l];
+        res->reached = reached;
+        res->length = found[l];
+        res->status = res->length == -1 ? BATCH_NO_PATH : BATCH_OK;
+        res->moves = res->length == -1 ? NULL : (char*)malloc(res->length + 1);
+        if (res->moves == NULL) continue;
+
+        res->moves[res->length] = '\0';
+        for (k = res->length; k > 0; k--) {
+            const unsigned long long* prev = solver->levels + (k - 1) * level_words;
+            for (d = 0; d < 4; d++) {
+                if (lane_neighbor(grp, l, cr, cc, d, &nr, &nc) && (prev[nr * BATCH_LANES + l] >> nc & 1)) break;
+            }
+            res->moves[k - 1] = batch_move_name[d];
+            cr = nr;
+            cc = nc;
+        }
+    }
+    grp->count = 0;
+}
+
+/**
+ * @brief Reads a whole maze file into buf.
+ * @return Number of bytes read, -1 if the file cannot be opened, or -2 if it is too large
+ */
+long read_maze_file(const char* path, char* buf) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) return -1;
+    size_t n = fread(buf, 1, BATCH_MAX_FILE, f);
+    int more = n == BATCH_MAX_FILE && fgetc(f) != EOF;
+    fclose(f);
+    return more ? -2 : (long)n;
+}
+
+/**
+ * @brief Hands the contents of one file to the solvers.
+ * @details Files that cannot be read or parsed get their result here; the others
+ *          are parsed into a spare item (waiting for one if all are in use) and
+ *          pushed onto the ready queue.
+ * @param run Shared state
+ * @param i Index of the file
+ * @param buf File contents
+ * @param len Length of buf, or the negative code of read_maze_file
+ */
+void ingest_file(BatchRun* run, int i, const char* buf, long len) {
+    BatchResult* res = &run->results[i];
+    memset(res, 0, sizeof(BatchResult));
+    res->length = -1;
+    if (len < 0) {
+        res->status = len == -1 ? BATCH_UNREADABLE : BATCH_TOO_LARGE;
+        return;
+    }
+
+    BatchItem* item = (BatchItem*)bqueue_pop(&run->spare);
+    res->status = parse_grid(buf, (size_t)len, &item->grid);
+    if (res->status != BATCH_OK) {
+        bqueue_push(&run->spare, item);
+        return;
+    }
+    item->index = i;
+    bqueue_push(&run->ready, item);
+}
+
+/**
+ * @brief Thread body of the fallback readers: reads files one at a time with stdio.
+ */
+THREAD_FUNC(batch_reader) {
+    BatchRun* run = *(BatchRun**)arg;
+    char* buf = (char*)malloc(BATCH_MAX_FILE);
+    int i;
+
+    while ((i = atomic_fetch_add_int(&run->next, 1)) < run->count) {
+        ingest_file(run, i, buf, buf ? read_maze_file(run->files[i], buf) : -1);
+    }
+    free(buf);
+    THREAD_RETURN;
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * @brief The mapped rings of an io_uring instance, driven with raw system calls.
+ */
+typedef struct {
+    int fd;                             /**< Ring file descriptor */
+    void* sq_ring;                      /**< Mapped submission ring */
+    void* cq_ring;                      /**< Mapped completion ring (may equal sq_ring) */
+    size_t sq_size, cq_size;            /**< Sizes of the two mappings */
+    struct io_uring_sqe* sqes;          /**< Mapped submission entries */
+    size_t sqes_size;                   /**< Size of that mapping */
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe* cqes;          /**< Completion entries */
+    unsigned tail;                      /**< Submission tail including unpublished entries */
+    unsigned submitted;                 /**< Entries already passed to the kernel */
+} Uring;
+
+/**
+ * @brief A file being read through the ring: open, then read, then close.
+ */
+typedef struct {
+    int file;                   /**< Index of the file, -1 if the slot is idle */
+    int fd;                     /**< Descriptor once opened */
+    int stage;                  /**< IORING_OP_OPENAT, IORING_OP_READ or IORING_OP_CLOSE */
+    char* buf;                  /**< BATCH_MAX_FILE + 1 bytes */
+} RingSlot;
+
+/**
+ * @brief Unmaps the rings and closes the ring descriptor.
+ */
+void uring_close(Uring* u) {
+    if (u->sqes != NULL) munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring != NULL && u->cq_ring != u->sq_ring) munmap(u->cq_ring, u->cq_size);
+    if (u->sq_ring != NULL) munmap(u->sq_ring, u->sq_size);
+    close(u->fd);
+}
+
+/**
+ * @brief Maps a void pointer to a ring field at offset off.
+ */
+unsigned* ring_field(void* ring, unsigned off) {
+    return (unsigned*)((char*)ring + off);
+}
+
+/**
+ * @brief Creates a ring and checks that the kernel can open, read and close files through it.
+ * @param u Receives the ring
+ * @param entries Submission queue size
+ * @return 1 on success, 0 if io_uring (or one of those operations) is unavailable
+ */
+int uring_open(Uring* u, unsigned entries) {
+    struct io_uring_params p;
+    struct io_uring_probe* probe;
+    int ops[3] = { IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_CLOSE };
+    int ok, k;
+
+    memset(&p, 0, sizeof(p));
+    memset(u, 0, sizeof(Uring));
+    u->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (u->fd < 0) return 0;
+
+    u->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (u->cq_size > u->sq_size) u->sq_size = u->cq_size;
+        u->cq_size = u->sq_size;
+    }
+    u->sq_ring = mmap(NULL, u->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQ_RING);
+    if (u->sq_ring == MAP_FAILED) u->sq_ring = NULL;
+    if (p.features & IORING_FEAT_SINGLE_MMAP) u->cq_ring = u->sq_ring;
+    else {
+        u->cq_ring = mmap(NULL, u->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_CQ_RING);
+        if (u->cq_ring == MAP_FAILED) u->cq_ring = NULL;
+    }
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    u->sqes = (struct io_uring_sqe*)mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, u->fd, IORING_OFF_SQES);
+    if (u->sqes == MAP_FAILED) u->sqes = NULL;
+    if (u->sq_ring == NULL || u->cq_ring == NULL || u->sqes == NULL) {
+        uring_close(u);
+        return 0;
+    }
+
+    u->sq_tail = ring_field(u->sq_ring, p.sq_off.tail);
+    u->sq_mask = ring_field(u->sq_ring, p.sq_off.ring_mask);
+    u->sq_array = ring_field(u->sq_ring, p.sq_off.array);
+    u->cq_head = ring_field(u->cq_ring, p.cq_off.head);
+    u->cq_tail = ring_field(u->cq_ring, p.cq_off.tail);
+    u->cq_mask = ring_field(u->cq_ring, p.cq_off.ring_mask);
+    u->cqes = (struct io_uring_cqe*)ring_field(u->cq_ring, p.cq_off.cqes);
+    u->tail = u->submitted = *u->sq_tail;
+
+    probe = (struct io_uring_probe*)calloc(1, sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op));
+    ok = probe != NULL && syscall(__NR_io_uring_register, u->fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (k = 0; ok && k < 3; k++) {
+        ok = ops[k] <= probe->last_op && (probe->ops[ops[k]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    if (!ok) uring_close(u);
+    return ok;
+}
+
+/**
+ * @brief Claims the next submission entry (published by uring_wait).
+ * @param u Ring with room for one more entry
+ * @param op Operation code
+ * @param fd File descriptor the operation works on
+ * @param slot Slot index, returned in the completion
+ */
+struct io_uring_sqe* uring_prepare(Uring* u, int op, int fd, int slot) {
+    unsigned idx = u->tail & *u->sq_mask;
+    struct io_uring_sqe* sqe = &u->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = (unsigned char)op;
+    sqe->fd = fd;
+    sqe->user_data = (unsigned long long)slot;
+    u->sq_array[idx] = idx;
+    u->tail++;
+    return sqe;
+}
+
+/**
+ * @brief Submits the prepared entries and waits for at least one completion.
+ * @return 1 on success, 0 if the kernel rejected the call
+ */
+int uring_wait(Uring* u) {
+    __atomic_store_n(u->sq_tail, u->tail, __ATOMIC_RELEASE);
+    while (1) {
+        long ret = syscall(__NR_io_uring_enter, u->fd, u->tail - u->submitted, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret >= 0) {
+            u->submitted += (unsigned)ret;
+            return 1;
         }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) return 0;
     }
+}
 
-    if (sr == -1 || er == -1) {
-        set_color(RED);
-        printf("Maze must contain 'S' and 'E'!\n");
-        set_color(WHITE);
+/**
+ * @brief Starts the next unread file in an idle slot.
+ * @return 1 if a file was started, 0 if every file has been taken
+ */
+int ring_start(Uring* u, RingSlot* slots, int s, BatchRun* run) {
+    int i = atomic_fetch_add_int(&run->next, 1);
+    if (i >= run->count) {
+        slots[s].file = -1;
         return 0;
     }
-
+    slots[s].file = i;
+    slots[s].fd = -1;
+    slots[s].stage = IORING_OP_OPENAT;
+    struct io_uring_sqe* sqe = uring_prepare(u, IORING_OP_OPENAT, AT_FDCWD, s);
+    sqe->addr = (unsigned long long)(unsigned long)run->files[i];
+    sqe->open_flags = O_RDONLY;
     return 1;
 }
 
-/** @} */
-
 /**
- * @defgroup Display Maze Rendering
- * @{
+ * @brief Reads the batch files through io_uring, BATCH_RING_ENTRIES at a time.
+ * @details Every file is opened, read in one request and closed by the kernel, so
+ *          one system call submits and completes dozens of operations. Regular files
+ *          return a short read only at end of file, so one read of BATCH_MAX_FILE + 1
+ *          bytes gets the whole file or shows that it is too large.
+ * @return 1 if io_uring was used (files it could not finish are reported unreadable),
+ *         0 if it is unavailable
  */
+int ingest_uring(BatchRun* run) {
+    Uring u;
+    RingSlot slots[BATCH_RING_ENTRIES];
+    int in_flight = 0, s;
 
- /**
-  * @brief Clears the terminal screen and renders the maze grid with colored characters.
-  * @param grid The maze grid to display (can be original or modified copy)
-  * @param show_player If non-zero, renders the player position as red '^'
-  */
-void print_maze(const char grid[MAXR][MAXC], int show_player) {
-#ifdef _WIN32
-    system("cls");
-#else
-    system("clear");
-#endif  // Windows only; consider "clear" for Unix-like systems
+    if (!uring_open(&u, BATCH_RING_ENTRIES)) return 0;
+    for (s = 0; s < BATCH_RING_ENTRIES; s++) {
+        slots[s].buf = (char*)malloc(BATCH_MAX_FILE + 1);
+        slots[s].file = -1;
+        if (slots[s].buf != NULL) in_flight += ring_start(&u, slots, s, run);
+    }
 
-    int i, j;
-    for (i = 0; i < rows; i++) {
-        for (j = 0; j < cols; j++) {
-            char ch = grid[i][j];
+    while (in_flight > 0) {
+        if (!uring_wait(&u)) break;
+        unsigned head = *u.cq_head, tail = __atomic_load_n(u.cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++) {
+            struct io_uring_cqe* cqe = &u.cqes[head & *u.cq_mask];
+            RingSlot* slot = &slots[cqe->user_data];
+            int res = cqe->res;
+            in_flight--;
 
-            if (show_player && i == pr && j == pc) {
-                set_color(RED);
-                printf("^");
-                set_color(WHITE);
-            }
-            else if (ch == 'S' || ch == 'E') {
-                set_color(9);   // Bright blue
-                printf("%c", ch);
-                set_color(WHITE);
-            }
-            else if (ch == '^') {
-                set_color(RED); // Path markers
-                printf("^");
-                set_color(WHITE);
-            }
-            else if (ch == '#') {
-                set_color(YELLOW); // Walls
-                printf("%c", ch);
-                set_color(WHITE);
+            if (slot->stage == IORING_OP_OPENAT && res >= 0) {
+                struct io_uring_sqe* sqe = uring_prepare(&u, IORING_OP_READ, res, (int)cqe->user_data);
+                sqe->addr = (unsigned long long)(unsigned long)slot->buf;
+                sqe->len = BATCH_MAX_FILE + 1;
+                slot->fd = res;
+                slot->stage = IORING_OP_READ;
+                in_flight++;
             }
-            else if (ch == 'b') {
-                set_color(GREEN); // Shortest path cells
-                printf("%c", ch);
-                set_color(WHITE);
+            else if (slot->stage == IORING_OP_READ) {
+                uring_prepare(&u, IORING_OP_CLOSE, slot->fd, (int)cqe->user_data);
+                slot->stage = IORING_OP_CLOSE;
+                in_flight++;
+                ingest_file(run, slot->file, slot->buf, res < 0 ? -1 : res > BATCH_MAX_FILE ? -2 : res);
             }
             else {
-                printf("%c", ch);
+                if (slot->stage == IORING_OP_OPENAT) ingest_file(run, slot->file, NULL, -1);
+                in_flight += ring_start(&u, slots, (int)cqe->user_data, run);
             }
         }
-        printf("\n");
+        __atomic_store_n(u.cq_head, head, __ATOMIC_RELEASE);
     }
-    printf("\n");
+
+    uring_close(&u);
+    for (s = 0; s < BATCH_RING_ENTRIES; s++) {
+        if (slots[s].file != -1 && slots[s].stage != IORING_OP_CLOSE) {
+            if (slots[s].fd != -1) close(slots[s].fd);
+            ingest_file(run, slots[s].file, NULL, -1);
+        }
+        free(slots[s].buf);
+    }
+    return 1;
 }
 
-/** @} */
+#endif
 
 /**
- * @defgroup Movement Player Movement Logic
- * @{
+ * @brief Thread body of the reading stage: reads and parses every file, then closes the ready queue.
+ * @details Uses io_uring where the kernel supports it and otherwise BATCH_READERS
+ *          threads reading with stdio.
  */
+THREAD_FUNC(batch_ingest) {
+    BatchRun* run = (BatchRun*)arg;
+    BatchRun* items[BATCH_READERS];
+    int i;
 
- /**
-  * @brief Validates whether a cell is inside the maze and passable.
-  * @param r Row index
-  * @param c Column index
-  * @return 1 if the position is valid and not a wall, 0 otherwise
-  */
-int is_valid(int r, int c) {
-    if (r < 0 || r >= rows || c < 0 || c >= cols) return 0;
-    if (maze[r][c] == '#') return 0;
-    return 1;
+    run->readers = 0;
+#ifdef HAVE_IO_URING
+    ingest_uring(run);
+#endif
+    if (run->next < run->count) {
+        run->readers = BATCH_READERS;
+        for (i = 0; i < BATCH_READERS; i++) items[i] = run;
+        run_workers(batch_reader, items, sizeof(BatchRun*), BATCH_READERS);
+    }
+    bqueue_close(&run->ready);
+    THREAD_RETURN;
 }
 
 /**
- * @brief Handles player movement based on keyboard input.
- * @param ch Input character representing direction ('w','a','s','d') or other
+ * @brief Solves the mazes gathered in a solver's lane group and caches their results.
  */
-void move_player(char ch) {
-    int nr = pr, nc = pc;
-
-    if (ch == 'w' || ch == 'W') nr--;
-    else if (ch == 's' || ch == 'S') nr++;
-    else if (ch == 'a' || ch == 'A') nc--;
-    else if (ch == 'd' || ch == 'D') nc++;
-    else {
-        set_color(RED);
-        printf("Invalid movement! Use w, a, s, d or q to quit.\n");
-        set_color(WHITE);
-#ifdef _WIN32
-        Sleep(1000);
-#else
-        sleep(1);
-#endif
-        return;
-    }
+void lane_flush(BatchSolver* solver) {
+    LaneGroup* grp = solver->lanes;
+    int n = grp->count, l;
 
-    if (is_valid(nr, nc)) {
-        pr = nr;
-        pc = nc;
-    }
-    else {
-        set_color(RED);
-        printf("Invalid movement! Cannot go through walls or out of bounds.\n");
-        set_color(WHITE);
-#ifdef _WIN32
-        Sleep(1000);
-#else
-        sleep(1);
-#endif
-    }
+    atomic_fetch_add_int(&solver->run->lane_solved, n);
+    lane_solve(grp, solver, solver->run->results);
+    for (l = 0; l < n; l++) batch_cache_store(&grp->key[l], &solver->run->results[grp->index[l]]);
 }
 
-/** @} */
-
 /**
- * @defgroup Manual Manual Gameplay Mode
- * @{
+ * @brief Thread body of the solving stage: solves parsed mazes until the ready queue is closed.
+ * @details Mazes solved before come from the solution cache.
  */
+THREAD_FUNC(batch_solver) {
+    BatchSolver* solver = (BatchSolver*)arg;
+    BatchRun* run = solver->run;
+    BatchItem* item;
 
- /**
-  * @brief Interactive loop for manual maze navigation using WASD keys.
-  */
-void play_manual(void) {
-    pr = sr;
-    pc = sc;
-
-    while (1) {
-        print_maze(maze, 1);
+    while ((item = (BatchItem*)bqueue_pop(&run->ready)) != NULL) {
+        BatchResult* res = &run->results[item->index];
+        CacheRecord key;
+        char* moves;
 
-        if (pr == er && pc == ec) {
-            set_color(GREEN);
-            printf("Congratulations! You reached the exit!\n\n");
-            set_color(WHITE);
-            break;
+        batch_cache_key(&key, &item->grid);
+        if (cache_lookup(&key, &moves)) {
+            res->rows = item->grid.rows;
+            res->cols = item->grid.cols;
+            res->length = key.length;
+            res->reached = key.reached;
+            res->status = key.length == -1 ? BATCH_NO_PATH : BATCH_OK;
+            res->moves = moves;
+            if (key.length == -1) {
+                free(moves);
+                res->moves = NULL;
+            }
+            atomic_fetch_add_int(&run->cache_hits, 1);
+            bqueue_push(&run->spare, item);
+            continue;
         }
-
-        printf("Move (w a s d) or q to quit: ");
-        char ch;
-        scanf(" %c", &ch);
-
-        if (ch == 'q' || ch == 'Q') {
-            set_color(RED);
-            printf("You quit the game.\n");
-            set_color(WHITE);
-            return;
+        if (lane_fits(&item->grid)) {
+            lane_add(solver->lanes, &item->grid, item->index);
+            bqueue_push(&run->spare, item);
+            if (solver->lanes->count == BATCH_LANES) lane_flush(solver);
+            continue;
         }
-
-        move_player(ch);
+        solve_grid(&item->grid, solver->dist, solver->queue, res);
+        batch_cache_store(&key, res);
+        bqueue_push(&run->spare, item);
     }
+    if (solver->lanes->count > 0) lane_flush(solver);
+    THREAD_RETURN;
 }
 
-/** @} */
+/**
+ * @brief qsort comparator for C strings.
+ */
+int compare_strings(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
 
 /**
- * @defgroup BFS Shortest Path Computation (BFS)
- * @{
+ * @brief Appends a copy of a path to a growing array.
+ * @return 1 on success, 0 if out of memory (the array is left as it was)
  */
+int add_path(char*** files, int* count, int* cap, const char* dir, const char* name) {
+    if (*count == *cap) {
+        int grown_cap = *cap ? *cap * 2 : 256;
+        char** grown = (char**)realloc(*files, sizeof(char*) * grown_cap);
+        if (grown == NULL) return 0;
+        *files = grown;
+        *cap = grown_cap;
+    }
+    char* path = (char*)malloc(strlen(dir) + strlen(name) + 2);
+    if (path == NULL) return 0;
+    if (dir[0] != '\0') sprintf(path, "%s/%s", dir, name);
+    else strcpy(path, name);
+    (*files)[(*count)++] = path;
+    return 1;
+}
 
- /**
-  * @brief Reconstructs and marks the shortest path on the maze using parent information.
-  * @param parent_r 2D array of parent row indices from BFS
-  * @param parent_c 2D array of parent column indices from BFS
-  */
-void mark_shortest_path(int parent_r[MAXR][MAXC], int parent_c[MAXR][MAXC]) {
-    int cr = er, cc = ec;
-    int length = 0;
+/**
+ * @brief Frees a path array whose listing ran out of memory.
+ * @return -2, the out-of-memory code of list_maze_files
+ */
+int drop_paths(char*** files, int count) {
+    while (count > 0) free((*files)[--count]);
+    free(*files);
+    *files = NULL;
+    return -2;
+}
 
-    while (cr != sr || cc != sc) {
-        int tempr = parent_r[cr][cc];
-        int tempc = parent_c[cr][cc];
-        if (maze[cr][cc] != 'S' && maze[cr][cc] != 'E') {
-            maze[cr][cc] = 'b';
-        }
-        cr = tempr;
-        cc = tempc;
-        length++;
-    }
+/**
+ * @brief Lists the mazes to solve: every .txt file of a directory (sorted by name),
+ *        or every line of a list file.
+ * @param path Directory or list file
+ * @param files Receives a malloc'ed array of malloc'ed paths
+ * @return Number of paths, -1 if path cannot be opened, or -2 if out of memory
+ */
+int list_maze_files(const char* path, char*** files) {
+    int count = 0, cap = 0, ok = 1;
+    *files = NULL;
 
-    set_color(YELLOW);
-    printf("Shortest path (length: %d steps):\n", length);
-    set_color(WHITE);
 #ifdef _WIN32
-    Sleep(1300);
+    DWORD attr = GetFileAttributesA(path);
+    if (attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY)) {
+        WIN32_FIND_DATAA entry;
+        char pattern[MAX_PATH];
+        sprintf(pattern, "%.*s\\*.txt", MAX_PATH - 8, path);
+        HANDLE h = FindFirstFileA(pattern, &entry);
+        if (h != INVALID_HANDLE_VALUE) {
+            do {
+                if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) ok = add_path(files, &count, &cap, path, entry.cFileName);
+            } while (ok && FindNextFileA(h, &entry));
+            FindClose(h);
+        }
+        if (!ok) return drop_paths(files, count);
+        qsort(*files, count, sizeof(char*), compare_strings);
+        return count;
+    }
 #else
-    sleep(1);
+    DIR* dir = opendir(path);
+    if (dir != NULL) {
+        struct dirent* entry;
+        while (ok && (entry = readdir(dir)) != NULL) {
+            size_t n = strlen(entry->d_name);
+            if (n > 4 && strcmp(entry->d_name + n - 4, ".txt") == 0) ok = add_path(files, &count, &cap, path, entry->d_name);
+        }
+        closedir(dir);
+        if (!ok) return drop_paths(files, count);
+        qsort(*files, count, sizeof(char*), compare_strings);
+        return count;
+    }
 #endif
+
+    FILE* f = fopen(path, "r");
+    char line[1024];
+    if (f == NULL) return -1;
+    while (ok && fgets(line, sizeof(line), f) != NULL) {
+        size_t n = strlen(line);
+        while (n > 0 && (line[n - 1] == '\n' || line[n - 1] == '\r')) line[--n] = '\0';
+        if (n > 0) ok = add_path(files, &count, &cap, "", line);
+    }
+    fclose(f);
+    return ok ? count : drop_paths(files, count);
 }
 
 /**
- * @brief Computes the shortest path from 'S' to 'E' using Breadth-First Search.
- * @details Uses a queue and parent tracking to reconstruct the path.
+ * @brief Writes a CSV field in double quotes, doubling any quote inside it.
  */
-void bfs_shortest(void) {
-    int visited[MAXR][MAXC] = { 0 };
-    int parent_r[MAXR][MAXC];
-    int parent_c[MAXR][MAXC];
-    int found = 0;
+void csv_quoted(FILE* f, const char* text) {
+    fputc('"', f);
+    for (; *text; text++) {
+        if (*text == '"') fputc('"', f);
+        fputc(*text, f);
+    }
+    fputc('"', f);
+}
 
-    queue_init();
-    queue_push(sr, sc);
-    visited[sr][sc] = 1;
-    parent_r[sr][sc] = -1;
-    parent_c[sr][sc] = -1;
+/**
+ * @brief Writes one CSV line per maze: file, status, rows, cols, length, reached, moves.
+ * @return 1 on success, 0 if the results file cannot be written
+ */
+int write_batch_results(const char* path, const BatchRun* run) {
+    FILE* f = fopen(path, "w");
+    int i;
+    if (f == NULL) return 0;
+    fprintf(f, "file,status,rows,cols,length,reached,moves\n");
+    for (i = 0; i < run->count; i++) {
+        const BatchResult* res = &run->results[i];
+        csv_quoted(f, run->files[i]);
+        fprintf(f, ",%s,%d,%d,%d,%d,%s\n", batch_status_name[res->status], res->rows, res->cols, res->length, res->reached,
+            res->moves ? res->moves : "");
+    }
+    return fclose(f) == 0;
+}
 
-    while (!queue_empty() && !found) {
-        int cr, cc;
-        queue_pop(&cr, &cc);
+/**
+ * @brief Solves every maze of a directory or list file on a pool of threads and
+ *        writes the results as CSV.
+ * @details A reading thread loads and parses the files while the solver threads
+ *          work, so solvers never wait on file I/O; at most BATCH_QUEUE_DEPTH
+ *          parsed mazes are held in memory.
+ */
+void batch_solve(void) {
+    char source[260], out_path[260];
+    BatchRun run;
+    BatchSolver solvers[MAX_THREADS];
+    BatchItem* items;
+    thread_t ingest;
+    int summary[BATCH_STATUSES] = { 0 };
+    int n = cpu_count(), i, ok;
 
-        int d;
-        for (d = 0; d < 4; d++) {
-            int nr = cr + dr[d];
-            int nc = cc + dc[d];
+    set_color(CYAN);
+    printf("Directory of .txt mazes, or a file listing one maze per line: ");
+    set_color(WHITE);
+    read_line(source, sizeof(source));
+    set_color(CYAN);
+    printf("Results file (Enter for batch_results.csv): ");
+    set_color(WHITE);
+    read_line(out_path, sizeof(out_path));
+    if (out_path[0] == '\0') strcpy(out_path, "batch_results.csv");
 
-            if (!is_valid(nr, nc)) continue;
-            if (visited[nr][nc]) continue;
+    run.count = list_maze_files(source, &run.files);
+    if (run.count <= 0) {
+        set_color(RED);
+        printf(run.count == -2 ? "Error: not enough memory to list %s!\n"
+            : run.count < 0 ? "Error: %s cannot be opened!\n" : "No mazes found in %s!\n", source);
+        set_color(WHITE);
+        wait_for_enter();
+        return;
+    }
+    if (n > MAX_THREADS) n = MAX_THREADS;
+    if (n > run.count) n = run.count;
+    run.results = (BatchResult*)calloc(run.count, sizeof(BatchResult));
+    run.next = run.lane_solved = run.cache_hits = 0;
+    items = (BatchItem*)malloc(sizeof(BatchItem) * BATCH_QUEUE_DEPTH);
+    ok = run.results != NULL && items != NULL;
+    ok = bqueue_init(&run.ready, BATCH_QUEUE_DEPTH) && ok;
+    ok = bqueue_init(&run.spare, BATCH_QUEUE_DEPTH) && ok;
+    for (i = 0; i < n; i++) {
+        solvers[i].run = &run;
+        solvers[i].dist = (int(*)[MAXC])malloc(sizeof(int) * MAXR * MAXC);
+        solvers[i].queue = (int*)malloc(sizeof(int) * QSIZE);
+        solvers[i].lanes = (LaneGroup*)malloc(sizeof(LaneGroup));
+        solvers[i].levels = NULL;
+        solvers[i].level_cap = 0;
+        solvers[i].spill = (MazeGrid*)malloc(sizeof(MazeGrid));
+        ok = ok && solvers[i].dist != NULL && solvers[i].queue != NULL && solvers[i].lanes != NULL && solvers[i].spill != NULL;
+        if (solvers[i].lanes != NULL) solvers[i].lanes->count = 0;
+    }
 
-            visited[nr][nc] = 1;
-            parent_r[nr][nc] = cr;
-            parent_c[nr][nc] = cc;
-            queue_push(nr, nc);
+    cache_open();
+    double started = wall_seconds();
+    if (ok) {
+        for (i = 0; i < BATCH_QUEUE_DEPTH; i++) bqueue_push(&run.spare, &items[i]);
+        ok = thread_start(&ingest, batch_ingest, &run);
+    }
+    if (ok) {
+        run_workers(batch_solver, solvers, sizeof(BatchSolver), n);
+        thread_join(ingest);
+    }
+    cache_flush();
+    double seconds = wall_seconds() - started;
 
-            if (nr == er && nc == ec) {
-                found = 1;
-                break;
-            }
-        }
+    for (i = 0; i < n; i++) {
+        free(solvers[i].dist);
+        free(solvers[i].queue);
+        free(solvers[i].lanes);
+        free(solvers[i].levels);
+        free(solvers[i].spill);
     }
+    free(items);
+    bqueue_destroy(&run.ready);
+    bqueue_destroy(&run.spare);
 
-    if (!found) {
+    if (!ok) {
         set_color(RED);
-        printf("No path exists!\n");
+        printf("Error: not enough memory or threads for the batch!\n");
         set_color(WHITE);
-        return;
+    }
+    else {
+        for (i = 0; i < run.count; i++) summary[run.results[i].status]++;
+        set_color(YELLOW);
+        printf("%d mazes in %.2f s on %d solver thread%s (%.0f mazes/s), ", run.count, seconds, n, n == 1 ? "" : "s",
+            seconds > 0 ? run.count / seconds : 0.0);
+        if (run.readers == 0) printf("read with io_uring:\n");
+        else printf("read by %d threads:\n", run.readers);
+        set_color(WHITE);
+        for (i = 0; i < BATCH_STATUSES; i++) {
+            if (summary[i] > 0) printf("  %-18s %d\n", batch_status_name[i], summary[i]);
+        }
+        printf("  %d mazes searched %d at a time in bit-parallel lanes.\n", run.lane_solved, BATCH_LANES);
+        printf("  %d results taken from the solution cache.\n", run.cache_hits);
+        if (write_batch_results(out_path, &run)) printf("Results written to %s.\n", out_path);
+        else {
+            set_color(RED);
+            printf("Error: %s cannot be written!\n", out_path);
+            set_color(WHITE);
+        }
     }
 
-    mark_shortest_path(parent_r, parent_c);
-    print_maze(maze, 0);
+    for (i = 0; i < run.count; i++) {
+        free(run.files[i]);
+        if (run.results != NULL) free(run.results[i].moves);
+    }
+    free(run.files);
+    free(run.results);
+    wait_for_enter();
 }
 
 /** @} */
@@ -470,19 +7620,18 @@ int dfs_find_one_path(int r, int c, int visited[MAXR][MAXC]) {
     visited[r][c] = 1;
 
     // Randomize direction order to generate different paths
-    int dirs[4] = { 0, 1, 2, 3 };
+    int dirs[NUM_MOVES] = { 0, 1, 2, 3 };
     int i;
-    for (i = 3; i > 0; i--) {
+    for (i = NUM_MOVES - 1; i > 0; i--) {
         int j = rand() % (i + 1);
         int temp = dirs[i];
         dirs[i] = dirs[j];
         dirs[j] = temp;
     }
 
-    for (i = 0; i < 4; i++) {
-        int dir_idx = dirs[i];
-        int nr = r + dr[dir_idx];
-        int nc = c + dc[dir_idx];
+    for (i = 0; i < NUM_MOVES; i++) {
+        int nr, nc;
+        if (!neighbor_cell(r, c, dirs[i], &nr, &nc)) continue;
 
         if (is_valid(nr, nc) && !visited[nr][nc]) {
             if (dfs_find_one_path(nr, nc, visited)) {
@@ -504,6 +7653,18 @@ void show_some_solutions(void) {
     int count = 0;
     char user_answer;
 
+    if (!same_component(sr, sc, er, ec)) {
+        set_color(RED);
+        printf("No path exists between S and E!\n");
+        set_color(WHITE);
+#ifdef _WIN32
+        Sleep(1000);
+#else
+        sleep(1);
+#endif
+        return;
+    }
+
     set_color(YELLOW);
     printf("Searching for possible paths...\n\n");
     set_color(WHITE);
@@ -585,28 +7746,54 @@ void show_some_solutions(void) {
 
  /**
   * @brief Displays the main menu and reads the user's selection.
-  * @return The selected option (1–4)
+  * @return The selected option (1–21)
   */
 int show_menu(void) {
-    int choice;
+    int choice = 0;
 
     set_color(CYAN);
     printf("\n=== Maze Game Menu ===\n");
     printf("1 - Play manually (WASD)\n");
     printf("2 - Show some possible solutions (up to %d paths)\n", MAX_PATHS_TO_SHOW);
     printf("3 - Show shortest path (BFS)\n");
-    printf("4 - Exit\n");
+    printf("4 - Show cheapest path over weighted terrain\n");
+    printf("5 - Evacuation: nearest exits (multi-source BFS)\n");
+    printf("6 - Shortest-path DAG and number of shortest paths\n");
+    printf("7 - Show chokepoints (cells on every path)\n");
+    printf("8 - Best walls to remove (top %d)\n", WALL_TOP_K);
+    printf("9 - Shortest path breaking up to k walls\n");
+    printf("10 - Shortest route through all waypoints (K)\n");
+    printf("11 - Shortest path with keys and doors\n");
+    printf("12 - Shortest path with portal-aware A*\n");
+    printf("13 - Solve multi-floor building (3D BFS)\n");
+    printf("14 - Earliest arrival with periodic gates\n");
+    printf("15 - Edit walls with live shortest path (LPA*)\n");
+    printf("16 - Explore the maze without seeing it (D* Lite)\n");
+    printf("17 - Low-memory solvers and their memory use\n");
+    printf("18 - External-memory BFS with a distance file\n");
+    printf("19 - Partitioned BFS over worker processes\n");
+    printf("20 - Batch-solve a directory or list of mazes\n");
+    printf("21 - Exit\n");
     printf("Your choice: ");
     set_color(WHITE);
     scanf("%d", &choice);
+    skip_line();
     return choice;
 }
 
 /**
  * @brief Program entry point and main control loop.
+ * @details Started as "<program> --bfs-worker k n", the program instead runs worker k
+ *          of a partitioned BFS over its standard input and output.
  * @return 0 on normal termination
  */
-int main(void) {
+int main(int argc, char** argv) {
+    if (argc == 4 && strcmp(argv[1], PARTITION_WORKER_FLAG) == 0) {
+        if (!load_maze()) return 1;
+        partition_worker(atoi(argv[2]), atoi(argv[3]), STDIN_CHANNEL, STDOUT_CHANNEL);
+        return 0;
+    }
+
     srand((unsigned int)time(NULL));
 
     if (!load_maze()) {
@@ -629,6 +7816,57 @@ int main(void) {
             bfs_shortest();
         }
         else if (opt == 4) {
+            weighted_shortest();
+        }
+        else if (opt == 5) {
+            evacuation_analysis();
+        }
+        else if (opt == 6) {
+            shortest_path_dag();
+        }
+        else if (opt == 7) {
+            show_chokepoints();
+        }
+        else if (opt == 8) {
+            best_wall_removal();
+        }
+        else if (opt == 9) {
+            shortest_with_breaks();
+        }
+        else if (opt == 10) {
+            waypoint_route();
+        }
+        else if (opt == 11) {
+            keys_and_doors();
+        }
+        else if (opt == 12) {
+            astar_shortest();
+        }
+        else if (opt == 13) {
+            solve_building();
+        }
+        else if (opt == 14) {
+            timed_gates();
+        }
+        else if (opt == 15) {
+            edit_walls();
+        }
+        else if (opt == 16) {
+            explore_unknown();
+        }
+        else if (opt == 17) {
+            frugal_solvers();
+        }
+        else if (opt == 18) {
+            external_bfs();
+        }
+        else if (opt == 19) {
+            partitioned_analysis();
+        }
+        else if (opt == 20) {
+            batch_solve();
+        }
+        else if (opt == 21) {
             set_color(YELLOW);
             printf("Goodbye!\n");
             set_color(WHITE);